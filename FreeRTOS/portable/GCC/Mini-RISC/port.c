@@ -107,21 +107,110 @@ size_t xTaskReturnAddress = ( size_t ) portTASK_RETURN_ADDRESS;
 
 /*-----------------------------------------------------------*/
 
-void vPortSetupTimerInterrupt( void )
+/* Timer clock is at 1 kHz */
+#define F_CLK_TIM 1000UL
+#define TIMER_COUNTS_PER_TICK ( F_CLK_TIM / configTICK_RATE_HZ )
+#define TIMER_COUNT_NS        ( 1000000000ULL / F_CLK_TIM )
+#define TICK_NS               ( 1000000000ULL / configTICK_RATE_HZ )
+
+_Static_assert( F_CLK_TIM % configTICK_RATE_HZ == 0, "configTICK_RATE_HZ must divide the 1 kHz timer clock" );
+
+port_tick_stats_t port_tick_stats;
+
+/* RTC time of the last tick counted, advanced by exactly one period per tick
+ * so that the tick count follows the RTC across tickless sleeps. */
+static uint64_t tick_time_ns;
+
+/* RTC time the next timer interrupt is due, for the jitter measurement. */
+static uint64_t timer_due_ns;
+
+static void prvTimerStart( uint32_t count, uint32_t reload )
 {
 	TIMER->CR  = 0;
 	TIMER->SR  = 0;
-	TIMER->CNT = 0;
-/* Timer clock is at 1 kHz */
-#define F_CLK_TIM 1000UL
+	TIMER->CNT = count;
 	/* Ftimer = F_CLK_TIM / (ARR + 1) */
-	TIMER->ARR = (F_CLK_TIM - configTICK_RATE_HZ) / configTICK_RATE_HZ;
+	TIMER->ARR = reload - 1;
 	TIMER->CR  = TIMER_CR_EN | TIMER_CR_IE;
+}
+
+static void prvRecordJitter( uint64_t now )
+{
+	uint32_t jitter = (uint32_t)( now > timer_due_ns ? now - timer_due_ns : timer_due_ns - now );
+	port_tick_stats.jitter_total_ns += jitter;
+	port_tick_stats.jitter_samples++;
+	if (jitter > port_tick_stats.jitter_max_ns)
+		port_tick_stats.jitter_max_ns = jitter;
+}
+
+void vPortSetupTimerInterrupt( void )
+{
+	tick_time_ns = RTC->NSEC;
+	timer_due_ns = tick_time_ns + TICK_NS;
+	prvTimerStart(0, TIMER_COUNTS_PER_TICK);
 	minirisc_enable_interrupt(TIMER_INTERRUPT);
 }
 
 /*-----------------------------------------------------------*/
 
+#if ( configUSE_TICKLESS_IDLE == 1 )
+
+/* Called by the idle task, scheduler suspended, when no task is due for at
+ * least xExpectedIdleTime ticks: the timer is reprogrammed to fire once at the
+ * tick the kernel expects, then the tick count is stepped by the ticks the RTC
+ * saw go by, whichever interrupt ended the sleep. */
+void vPortSuppressTicksAndSleep( TickType_t xExpectedIdleTime )
+{
+	/* wfi still wakes up on a pending interrupt with interrupts masked, the
+	 * handler runs once they are enabled again at the end. */
+	portDISABLE_INTERRUPTS();
+	if (eTaskConfirmSleepModeStatus() == eAbortSleep) {
+		portENABLE_INTERRUPTS();
+		return;
+	}
+
+	/* The timer counts from now: round down to wake up early rather than
+	 * late, within what the 32-bit auto-reload register can time */
+	uint64_t now = RTC->NSEC;
+	uint64_t wake = tick_time_ns + xExpectedIdleTime * TICK_NS;
+	uint64_t counts = wake > now ? ( wake - now ) / TIMER_COUNT_NS : 0;
+	if (counts > 0xffffffffULL)
+		counts = 0xffffffffULL;
+	if (counts == 0) {
+		portENABLE_INTERRUPTS();
+		return;
+	}
+	prvTimerStart(0, (uint32_t)counts);
+	timer_due_ns = now + counts * TIMER_COUNT_NS;
+
+	minirisc_wait_for_interrupt();
+
+	now = RTC->NSEC;
+	if (TIMER->SR & TIMER_SR_UEF)
+		prvRecordJitter(now);
+	TickType_t ticks = now > tick_time_ns ? (TickType_t)( ( now - tick_time_ns ) / TICK_NS ) : 0;
+	if (ticks > xExpectedIdleTime)
+		ticks = xExpectedIdleTime;
+	tick_time_ns += ticks * TICK_NS;
+
+	/* Back to periodic ticks, in phase with the ticks counted. The timer
+	 * interrupt of the sleep, if any, is cleared: its tick is stepped below. */
+	uint32_t phase = now > tick_time_ns ? (uint32_t)( ( now - tick_time_ns ) / TIMER_COUNT_NS ) : 0;
+	if (phase >= TIMER_COUNTS_PER_TICK)
+		phase = TIMER_COUNTS_PER_TICK - 1;
+	prvTimerStart(phase, TIMER_COUNTS_PER_TICK);
+	timer_due_ns = now + ( TIMER_COUNTS_PER_TICK - phase ) * TIMER_COUNT_NS;
+	vTaskStepTick(ticks);
+
+	port_tick_stats.sleeps++;
+	port_tick_stats.ticks_suppressed += ticks;
+	portENABLE_INTERRUPTS();
+}
+
+#endif /* configUSE_TICKLESS_IDLE */
+
+/*-----------------------------------------------------------*/
+
 BaseType_t xPortStartScheduler( void )
 {
 extern void xPortStartFirstTask( void );
@@ -244,7 +333,15 @@ StackType_t* pxPortInitialiseStack(StackType_t *pxTopOfStack, TaskFunction_t pxC
 
 void timer_interrupt_handler()
 {
+	uint64_t now = RTC->NSEC;
+	/* The end of a tickless sleep clears the timer interrupt it counted */
+	if (!(TIMER->SR & TIMER_SR_UEF))
+		return;
 	TIMER->SR = 0;
+	prvRecordJitter(now);
+	timer_due_ns += TICK_NS;
+	tick_time_ns += TICK_NS;
+	port_tick_stats.ticks++;
 	int xSwitchRequired = xTaskIncrementTick();
 //	if (xSwitchRequired)
 //		xprintf("timer -> %c\n", xSwitchRequired ? 'Y' : ' ');
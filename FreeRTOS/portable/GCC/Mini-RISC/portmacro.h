@@ -105,6 +105,28 @@ extern size_t xCriticalNesting;
 
 /*-----------------------------------------------------------*/
 
+/* Tick timer. With configUSE_TICKLESS_IDLE the tick interrupt stops while
+ * the system is idle, the timer being set for the next task wake up. */
+#if ( configUSE_TICKLESS_IDLE == 1 )
+    extern void vPortSuppressTicksAndSleep( TickType_t xExpectedIdleTime );
+    #define portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime ) vPortSuppressTicksAndSleep( xExpectedIdleTime )
+#endif
+
+/* Jitter is the distance between a timer interrupt, periodic tick or end of
+ * a tickless sleep, and the RTC time it was due. */
+typedef struct {
+    uint32_t ticks;             /* tick interrupts */
+    uint32_t sleeps;            /* tickless sleeps */
+    uint32_t ticks_suppressed;  /* ticks stepped after the sleeps */
+    uint32_t jitter_max_ns;
+    uint32_t jitter_samples;
+    uint64_t jitter_total_ns;
+} port_tick_stats_t;
+
+extern port_tick_stats_t port_tick_stats;
+
+/*-----------------------------------------------------------*/
+
 /* Architecture specific optimisations. */
 #ifndef configUSE_PORT_OPTIMISED_TASK_SELECTION
     #define configUSE_PORT_OPTIMISED_TASK_SELECTION 1
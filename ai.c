@@ -0,0 +1,222 @@
+#include <string.h>
+#include "ai.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+TETRIS_TLS ai_weights_t ai_weights = {
+    .lines     = 760,
+    .height    = 510,
+    .holes     = 357,
+    .bumpiness = 184,
+};
+
+static inline int popcount16(uint16_t v) {
+    v = v - ((v >> 1) & 0x5555);
+    v = (v & 0x3333) + ((v >> 2) & 0x3333);
+    v = (v + (v >> 4)) & 0x0f0f;
+    return (v + (v >> 8)) & 0x1f;
+}
+
+static int32_t score(const uint8_t *heights, int holes, int lines) {
+    int height = heights[0];
+    int bumpiness = 0;
+    for (int c = 1; c < BOARD_WIDTH; c++) {
+        int d = heights[c] - heights[c - 1];
+        height += heights[c];
+        bumpiness += d < 0 ? -d : d;
+    }
+    return ai_weights.lines * lines - ai_weights.height * height -
+           ai_weights.holes * holes - ai_weights.bumpiness * bumpiness;
+}
+
+// Holes of the board before the placement: empty cells under a filled one
+static int count_holes(int top) {
+    uint16_t seen = 0;
+    int holes = 0;
+    for (int r = top; r < BOARD_HEIGHT; r++) {
+        uint16_t row = game_state.board_rows[r];
+        holes += popcount16(seen & ~row);
+        seen |= row;
+    }
+    return holes;
+}
+
+// Score after placing rotation m at (x, y) when rows are cleared: one pass
+// from the top over the rows that remain once the completed ones are
+// removed. Rows above `top` are empty before the placement and are skipped.
+static int32_t evaluate_clear(const shape_mask_t *m, int x, int y, int top) {
+    uint16_t rows[BOARD_HEIGHT];
+    int lines = 0;
+    int n = BOARD_HEIGHT;
+    
+    if (y + m->y_min < top) {
+        top = y + m->y_min > 0 ? y + m->y_min : 0; // cells above the board are lost
+    }
+    
+    // Place the piece and drop the completed rows, compacting from the bottom
+    for (int r = BOARD_HEIGHT - 1; r >= top; r--) {
+        uint16_t row = game_state.board_rows[r];
+        int pr = r - y;
+        if (pr >= m->y_min && pr <= m->y_max) {
+            row |= shape_row(m, pr, x);
+        }
+        if (row == BOARD_FULL_ROW) {
+            lines++;
+        } else {
+            rows[--n] = row;
+        }
+    }
+    
+    uint8_t heights[BOARD_WIDTH] = {0};
+    uint16_t seen = 0;
+    int holes = 0;
+    for (int r = n; r < BOARD_HEIGHT; r++) {
+        uint16_t row = rows[r];
+        uint16_t tops = row & ~seen;
+        holes += popcount16(seen & ~row);
+        seen |= row;
+        for (; tops; tops &= tops - 1) {
+            heights[__builtin_ctz(tops)] = BOARD_HEIGHT - r;
+        }
+    }
+    return score(heights, holes, lines);
+}
+
+// Score after placing rotation m at (x, y). Without a line clear only the
+// columns of the piece change: each one rises to the top of the piece and
+// gains a hole per empty cell between the piece and the old column top, so
+// the board features are updated from those of the search instead of
+// recounted. `holes` and `top` describe the board before the placement.
+// A piece slid under an overhang is below some column top, and the cells of a
+// piece ending partly above the board are lost: the update does not hold
+// there, the board is recounted as for a line clear.
+static int32_t evaluate(const shape_mask_t *m, int x, int y, int holes, int top) {
+    if (y + m->y_min < 0) {
+        return evaluate_clear(m, x, y, top);
+    }
+    for (int r = m->y_min; r <= m->y_max; r++) {
+        if ((game_state.board_rows[y + r] | shape_row(m, r, x)) == BOARD_FULL_ROW) {
+            return evaluate_clear(m, x, y, top);
+        }
+    }
+    for (int c = m->x_min; c <= m->x_max; c++) {
+        if (y + m->col_bottom[c] >= BOARD_HEIGHT - game_state.col_height[x + c]) {
+            return evaluate_clear(m, x, y, top);
+        }
+    }
+    
+    uint8_t heights[BOARD_WIDTH];
+    memcpy(heights, game_state.col_height, sizeof(heights));
+    for (int c = m->x_min; c <= m->x_max; c++) {
+        int column_top = BOARD_HEIGHT - heights[x + c];
+        int piece_top = m->col_bottom[c];
+        while (piece_top > m->y_min && (m->rows[piece_top - 1] >> c & 1)) {
+            piece_top--;
+        }
+        holes += column_top - (y + m->col_bottom[c]) - 1;
+        heights[x + c] = BOARD_HEIGHT - (y + piece_top);
+    }
+    return score(heights, holes, 0);
+}
+
+int ai_list_moves(ai_move_t *moves) {
+    int type = game_state.current_shape_type;
+    int x0 = game_state.current_x;
+    int y = game_state.current_y;
+    int n = 0;
+    
+    int stack = 0;
+    for (int c = 0; c < BOARD_WIDTH; c++) {
+        if (game_state.col_height[c] > stack) {
+            stack = game_state.col_height[c];
+        }
+    }
+    int top = BOARD_HEIGHT - stack;
+    int holes = count_holes(top);
+    
+    // Rotations reachable in place, without wall kicks, by the turns
+    // ai_play() makes: up to two clockwise or one counter-clockwise
+    int cur = game_state.current_rotation;
+    int reachable = 1 << cur;
+    if (!shape_collides(type, (cur + 1) & 3, x0, y)) {
+        reachable |= 1 << ((cur + 1) & 3);
+        if (!shape_collides(type, (cur + 2) & 3, x0, y)) {
+            reachable |= 1 << ((cur + 2) & 3);
+        }
+    }
+    if (!shape_collides(type, (cur + 3) & 3, x0, y)) {
+        reachable |= 1 << ((cur + 3) & 3);
+    }
+    
+    for (int rot = 0; rot < 4; rot++) {
+        const shape_mask_t *m = &shape_masks[type][rot];
+        if (!(reachable & (1 << rot))) {
+            continue;
+        }
+        
+        // Skip rotations with the same cells as an earlier one (O piece)
+        int duplicate = 0;
+        for (int prev = 0; prev < rot; prev++) {
+            if ((reachable & (1 << prev)) &&
+                !memcmp(shape_masks[type][prev].rows, m->rows, sizeof(m->rows))) {
+                duplicate = 1;
+                break;
+            }
+        }
+        if (duplicate) {
+            continue;
+        }
+        
+        // Columns reachable sliding along the current row, then drop straight down
+        int x_first = x0;
+        while (!shape_collides(type, rot, x_first - 1, y)) {
+            x_first--;
+        }
+        for (int x = x_first; !shape_collides(type, rot, x, y); x++) {
+            int land = landing_y(type, rot, x, y);
+            moves[n].rotation = rot;
+            moves[n].x = x;
+            moves[n].score = evaluate(m, x, land, holes, top);
+            n++;
+        }
+    }
+    return n;
+}
+
+int ai_find_move(ai_move_t *move) {
+    ai_move_t moves[AI_MAX_MOVES];
+    int n = ai_list_moves(moves);
+    for (int i = 0; i < n; i++) {
+        if (i == 0 || moves[i].score > move->score) {
+            *move = moves[i];
+        }
+    }
+    return n > 0;
+}
+
+void ai_apply(const ai_move_t *move) {
+    // Same turns as the search: the unkicked test of each rotation succeeds
+    int turns = (move->rotation - game_state.current_rotation) & 3;
+    if (turns == 3) {
+        rotate_shape(-1);
+    } else {
+        for (int i = 0; i < turns; i++) {
+            rotate_shape(1);
+        }
+    }
+    while (game_state.current_x != move->x) {
+        if (!move_shape(game_state.current_x < move->x ? 1 : -1, 0)) {
+            break; // blocked, drop where it stands
+        }
+    }
+    hard_drop();
+}
+
+void ai_play() {
+    ai_move_t move;
+    if (ai_find_move(&move)) {
+        ai_apply(&move);
+    } else {
+        hard_drop();
+    }
+}
+
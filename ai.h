@@ -0,0 +1,48 @@
+#ifndef AI_H
+#define AI_H
+
+#include <stdint.h>
+#include "tetris.h"
+
+/* Autoplay agent. For the falling piece it tries every distinct rotation at
+ * every column, drops it straight down on a copy of the bitboard and scores
+ * the result with a weighted heuristic. The best placement is then played
+ * through the regular core API (rotate_shape, move_shape, hard_drop).
+ *
+ * The search touches at most 4 x BOARD_WIDTH placements and each evaluation is
+ * one pass over BOARD_HEIGHT row masks, so its cost is bounded and small
+ * enough to run inside a simulation step.
+ */
+
+// Heuristic weights, integers scaled by 1000
+typedef struct {
+    int32_t lines;      // per line cleared (reward)
+    int32_t height;     // per row of aggregate column height (penalty)
+    int32_t holes;      // per empty cell below a column top (penalty)
+    int32_t bumpiness;  // per row of height difference between neighbours (penalty)
+} ai_weights_t;
+
+extern TETRIS_TLS ai_weights_t ai_weights; // per thread in host builds, for tuning
+
+typedef struct {
+    int rotation;
+    int x;
+    int32_t score;
+} ai_move_t;
+
+// Reachable placements of the falling piece: every rotation then every column
+#define AI_MAX_MOVES (4 * BOARD_WIDTH)
+
+// Fill moves with the reachable placements and their scores, return how many
+int  ai_list_moves(ai_move_t *moves);
+
+// Best placement of the falling piece, returns 0 if it has none
+int  ai_find_move(ai_move_t *move);
+
+// Play a placement from ai_list_moves() now, ending with a hard drop
+void ai_apply(const ai_move_t *move);
+
+// Play the best placement
+void ai_play();
+
+#endif /* AI_H */
@@ -0,0 +1,108 @@
+#include "font.h"
+#include "raster.h"
+
+
+#define FONT_FIRST ' '
+#define FONT_LAST  'Z'
+
+// One byte per glyph row, bit 4 is the leftmost column
+static const uint8_t font_glyphs[FONT_LAST - FONT_FIRST + 1][FONT_GLYPH_HEIGHT] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ' '
+    {0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04}, // '!'
+    {0x0a, 0x0a, 0x0a, 0x00, 0x00, 0x00, 0x00}, // '"'
+    {0x0a, 0x0a, 0x1f, 0x0a, 0x1f, 0x0a, 0x0a}, // '#'
+    {0x04, 0x0f, 0x14, 0x0e, 0x05, 0x1e, 0x04}, // '$'
+    {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}, // '%'
+    {0x08, 0x14, 0x14, 0x08, 0x15, 0x12, 0x0d}, // '&'
+    {0x06, 0x06, 0x04, 0x08, 0x00, 0x00, 0x00}, // '\''
+    {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02}, // '('
+    {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08}, // ')'
+    {0x04, 0x15, 0x0e, 0x1f, 0x0e, 0x15, 0x04}, // '*'
+    {0x00, 0x04, 0x04, 0x1f, 0x04, 0x04, 0x00}, // '+'
+    {0x00, 0x00, 0x00, 0x00, 0x06, 0x06, 0x04}, // ','
+    {0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00}, // '-'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x06}, // '.'
+    {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}, // '/'
+    {0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e}, // '0'
+    {0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e}, // '1'
+    {0x0e, 0x11, 0x01, 0x0e, 0x10, 0x10, 0x1f}, // '2'
+    {0x1f, 0x01, 0x02, 0x06, 0x01, 0x11, 0x0e}, // '3'
+    {0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02}, // '4'
+    {0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e}, // '5'
+    {0x07, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e}, // '6'
+    {0x1f, 0x01, 0x01, 0x02, 0x04, 0x08, 0x10}, // '7'
+    {0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e}, // '8'
+    {0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x1c}, // '9'
+    {0x00, 0x00, 0x04, 0x00, 0x04, 0x00, 0x00}, // ':'
+    {0x00, 0x00, 0x04, 0x00, 0x04, 0x04, 0x08}, // ';'
+    {0x01, 0x02, 0x04, 0x08, 0x04, 0x02, 0x01}, // '<'
+    {0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00}, // '='
+    {0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08}, // '>'
+    {0x0e, 0x11, 0x01, 0x06, 0x04, 0x00, 0x04}, // '?'
+    {0x0e, 0x11, 0x15, 0x17, 0x16, 0x10, 0x0f}, // '@'
+    {0x04, 0x0a, 0x11, 0x11, 0x1f, 0x11, 0x11}, // 'A'
+    {0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e}, // 'B'
+    {0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e}, // 'C'
+    {0x1e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x1e}, // 'D'
+    {0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f}, // 'E'
+    {0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10}, // 'F'
+    {0x0f, 0x11, 0x10, 0x10, 0x13, 0x11, 0x0f}, // 'G'
+    {0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11}, // 'H'
+    {0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e}, // 'I'
+    {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c}, // 'J'
+    {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}, // 'K'
+    {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f}, // 'L'
+    {0x11, 0x1b, 0x15, 0x15, 0x15, 0x11, 0x11}, // 'M'
+    {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}, // 'N'
+    {0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e}, // 'O'
+    {0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10}, // 'P'
+    {0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d}, // 'Q'
+    {0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11}, // 'R'
+    {0x0e, 0x11, 0x10, 0x0e, 0x01, 0x11, 0x0e}, // 'S'
+    {0x1f, 0x15, 0x04, 0x04, 0x04, 0x04, 0x04}, // 'T'
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e}, // 'U'
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04}, // 'V'
+    {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a}, // 'W'
+    {0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11}, // 'X'
+    {0x11, 0x11, 0x0a, 0x04, 0x04, 0x04, 0x04}, // 'Y'
+    {0x1f, 0x01, 0x02, 0x0e, 0x08, 0x10, 0x1f}, // 'Z'
+};
+
+
+int font_draw_char(uint32_t *fb, int x, int y, char c, uint32_t fg, uint32_t bg)
+{
+    static const uint8_t blank[FONT_GLYPH_HEIGHT];
+    const uint8_t *glyph = blank;
+    uint32_t line[FONT_CHAR_WIDTH];
+
+    if (c >= 'a' && c <= 'z') {
+        c -= 'a' - 'A';
+    }
+    if (c >= FONT_FIRST && c <= FONT_LAST) {
+        glyph = font_glyphs[c - FONT_FIRST];
+    }
+
+    // Each glyph row is expanded once into a line of pixels, then copied
+    // FONT_SCALE times. The last row and column are the spacing.
+    for (int r = 0; r <= FONT_GLYPH_HEIGHT; r++) {
+        uint8_t bits = r < FONT_GLYPH_HEIGHT ? glyph[r] : 0;
+        for (int i = 0; i < FONT_CHAR_WIDTH; i++) {
+            int col = i / FONT_SCALE;
+            line[i] = col < FONT_GLYPH_WIDTH && (bits & (0x10 >> col)) ? fg : bg;
+        }
+        for (int s = 0; s < FONT_SCALE; s++) {
+            raster_copy_span(&RASTER_PIXEL(fb, x, y + r * FONT_SCALE + s), line, FONT_CHAR_WIDTH);
+        }
+    }
+    return x + FONT_CHAR_WIDTH;
+}
+
+
+int font_draw_string(uint32_t *fb, int x, int y, const char *s, uint32_t fg, uint32_t bg)
+{
+    while (*s) {
+        x = font_draw_char(fb, x, y, *s++, fg, bg);
+    }
+    return x;
+}
+
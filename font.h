@@ -0,0 +1,25 @@
+#ifndef FONT_H
+#define FONT_H
+
+#include <stdint.h>
+
+/* 1-bit 5x7 bitmap font for the on-screen HUD. Glyphs cover ASCII ' ' to 'Z'
+ * (lowercase is drawn as uppercase, anything else as a blank) and are drawn
+ * opaque, FONT_SCALE times enlarged, so redrawing a string over an older one
+ * needs no clearing.
+ */
+
+#define FONT_GLYPH_WIDTH  5
+#define FONT_GLYPH_HEIGHT 7
+#define FONT_SCALE        2
+
+// Size of a character cell on screen, including one column/row of spacing
+#define FONT_CHAR_WIDTH  ((FONT_GLYPH_WIDTH + 1) * FONT_SCALE)
+#define FONT_CHAR_HEIGHT ((FONT_GLYPH_HEIGHT + 1) * FONT_SCALE)
+
+// Unclipped: the caller guarantees the character cells are on screen.
+// Returns the x coordinate following the last character.
+int font_draw_char(uint32_t *fb, int x, int y, char c, uint32_t fg, uint32_t bg);
+int font_draw_string(uint32_t *fb, int x, int y, const char *s, uint32_t fg, uint32_t bg);
+
+#endif /* FONT_H */
@@ -0,0 +1,285 @@
+/* Equivalence test of the bitboard engine, built natively with `make host`.
+ *
+ * Keeps a reference board in the representation the game used before the
+ * bitboard: int cells, column-major, a cell holding its shape type + 1, with
+ * collisions tested cell by cell on the shapes[] lists and full rows shifted
+ * down cell by cell. Actions drive the game core through its public API, most
+ * pieces steered to the placement where they land lowest so that lines clear
+ * often, the others moved at random. After each action, the reference
+ * predicts the result:
+ *   - side moves and soft drops: the new position of the piece,
+ *   - rotations: a position that does not collide,
+ *   - hard drops: the landing row, then the whole board (occupancy, colors,
+ *     row fill counts, column heights), score, lines and level after the lock
+ *     and the line clears.
+ * For each new piece, shape_collides() is also compared with the reference
+ * at every rotation over a margin around the board.
+ *
+ * Exits with status 1 at the first divergence.
+ *
+ * Usage: board_equiv [-n actions] [-s seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "tetris.h"
+
+
+static int ref_board[BOARD_WIDTH][BOARD_HEIGHT];
+static int ref_score, ref_lines, ref_level;
+
+static const tetris_action_t action_mix[8] = {
+    ACTION_LEFT, ACTION_LEFT, ACTION_RIGHT, ACTION_RIGHT,
+    ACTION_ROTATE, ACTION_ROTATE_CCW, ACTION_SOFT_DROP, ACTION_HARD_DROP
+};
+
+
+static int ref_collides(int type, int rotation, int x, int y)
+{
+    for (int i = 0; i < 4; i++) {
+        int cx = x + shapes[type][rotation][i][0];
+        int cy = y + shapes[type][rotation][i][1];
+        if (cx < 0 || cx >= BOARD_WIDTH || cy >= BOARD_HEIGHT)
+            return 1;
+        if (cy >= 0 && ref_board[cx][cy])
+            return 1;
+    }
+    return 0;
+}
+
+
+static void ref_lock(int type, int rotation, int x, int y)
+{
+    for (int i = 0; i < 4; i++) {
+        int cy = y + shapes[type][rotation][i][1];
+        if (cy >= 0)
+            ref_board[x + shapes[type][rotation][i][0]][cy] = type + 1;
+    }
+}
+
+
+static void ref_check_line_clear()
+{
+    int lines_cleared = 0;
+    for (int y = BOARD_HEIGHT - 1; y >= 0; y--) {
+        int line_full = 1;
+        for (int x = 0; x < BOARD_WIDTH; x++) {
+            if (!ref_board[x][y]) {
+                line_full = 0;
+                break;
+            }
+        }
+        if (line_full) {
+            for (int ny = y; ny > 0; ny--) {
+                for (int x = 0; x < BOARD_WIDTH; x++)
+                    ref_board[x][ny] = ref_board[x][ny - 1];
+            }
+            for (int x = 0; x < BOARD_WIDTH; x++)
+                ref_board[x][0] = 0;
+            lines_cleared++;
+            y++; // recheck the row that moved down
+        }
+    }
+    if (lines_cleared > 0) {
+        static int score_multiplier[] = {0, 40, 100, 300, 1200};
+        ref_score += score_multiplier[lines_cleared] * (ref_level + 1);
+        ref_lines += lines_cleared;
+        ref_level = ref_lines / 10;
+    }
+}
+
+
+static void ref_reset()
+{
+    memset(ref_board, 0, sizeof(ref_board));
+    ref_score = ref_lines = ref_level = 0;
+}
+
+
+// Whole board and counters against the reference, 0 when they differ
+static int same_board(uint64_t action)
+{
+    for (int y = 0; y < BOARD_HEIGHT; y++) {
+        int fill = 0;
+        for (int x = 0; x < BOARD_WIDTH; x++) {
+            int occupied = (game_state.board_rows[y] >> x) & 1;
+            if (occupied != (ref_board[x][y] != 0) || game_state.board_colors[y][x] != ref_board[x][y]) {
+                fprintf(stderr, "action %llu: cell (%d, %d) is %d/%d, reference %d\n",
+                        (unsigned long long)action, x, y, occupied, game_state.board_colors[y][x], ref_board[x][y]);
+                return 0;
+            }
+            fill += occupied;
+        }
+        if (game_state.board_rows[y] & ~BOARD_FULL_ROW || game_state.row_fill[y] != fill) {
+            fprintf(stderr, "action %llu: row %d mask %04x, fill %d, reference fill %d\n",
+                    (unsigned long long)action, y, game_state.board_rows[y], game_state.row_fill[y], fill);
+            return 0;
+        }
+    }
+    for (int x = 0; x < BOARD_WIDTH; x++) {
+        int height = 0;
+        for (int y = 0; y < BOARD_HEIGHT && !height; y++) {
+            if (ref_board[x][y])
+                height = BOARD_HEIGHT - y;
+        }
+        if (game_state.col_height[x] != height) {
+            fprintf(stderr, "action %llu: column %d height %d, reference %d\n",
+                    (unsigned long long)action, x, game_state.col_height[x], height);
+            return 0;
+        }
+    }
+    if (game_state.score != ref_score || game_state.lines_cleared != ref_lines || game_state.level != ref_level) {
+        fprintf(stderr, "action %llu: score %d lines %d level %d, reference %d %d %d\n",
+                (unsigned long long)action, game_state.score, game_state.lines_cleared, game_state.level,
+                ref_score, ref_lines, ref_level);
+        return 0;
+    }
+    return 1;
+}
+
+
+// Rotation and column where the piece lands lowest, to clear lines often
+static void lowest_placement(int type, int *target_rot, int *target_x)
+{
+    int best = -1;
+    for (int rot = 0; rot < 4; rot++) {
+        for (int x = -3; x < BOARD_WIDTH; x++) {
+            if (ref_collides(type, rot, x, 0))
+                continue;
+            int y = 0;
+            while (!ref_collides(type, rot, x, y + 1))
+                y++;
+            int depth = 0;
+            for (int i = 0; i < 4; i++)
+                depth += y + shapes[type][rot][i][1];
+            if (depth > best) {
+                best = depth;
+                *target_rot = rot;
+                *target_x = x;
+            }
+        }
+    }
+}
+
+
+static int same_collisions(uint64_t action)
+{
+    int type = game_state.current_shape_type;
+    for (int rot = 0; rot < 4; rot++) {
+        for (int x = -4; x < BOARD_WIDTH + 4; x++) {
+            for (int y = -4; y < BOARD_HEIGHT + 4; y++) {
+                if (!shape_collides(type, rot, x, y) != !ref_collides(type, rot, x, y)) {
+                    fprintf(stderr, "action %llu: shape %d rotation %d at (%d, %d) collides %d, reference %d\n",
+                            (unsigned long long)action, type, rot, x, y,
+                            shape_collides(type, rot, x, y), ref_collides(type, rot, x, y));
+                    return 0;
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+
+int main(int argc, char **argv)
+{
+    uint64_t nb_actions = 1000000;
+    uint32_t seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+            case 'n': nb_actions = strtoull(optarg, NULL, 0); break;
+            case 's': seed = strtoul(optarg, NULL, 0);        break;
+            default:
+                fprintf(stderr, "Usage: %s [-n actions] [-s seed]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    uint32_t rng = ~seed ? ~seed : 1; // actions, distinct from the pieces
+    uint64_t pieces = 0, lines = 0;
+    int steps = 0, target_rot = -1, target_x = 0;
+    tetris_init(seed);
+    ref_reset();
+    if (!same_board(0) || !same_collisions(0))
+        return 1;
+
+    for (uint64_t i = 1; i <= nb_actions; i++) {
+        int type = game_state.current_shape_type;
+        int rot = game_state.current_rotation;
+        int x = game_state.current_x;
+        int y = game_state.current_y;
+
+        // Three pieces in four are steered to their lowest placement, the
+        // others get random actions, one hard drop in eight
+        tetris_action_t action = action_mix[tetris_rand(&rng) % 8];
+        if (steps++ == 0 && tetris_rand(&rng) % 4) {
+            target_rot = -1;
+            lowest_placement(type, &target_rot, &target_x);
+        }
+        if (target_rot >= 0) {
+            if (steps > 12)
+                action = ACTION_HARD_DROP; // kicked away from the target
+            else if (rot != target_rot)
+                action = ACTION_ROTATE;
+            else if (x != target_x)
+                action = x < target_x ? ACTION_RIGHT : ACTION_LEFT;
+            else
+                action = ACTION_HARD_DROP;
+        }
+
+        if (action == ACTION_HARD_DROP) {
+            int land = y;
+            while (!ref_collides(type, rot, x, land + 1))
+                land++;
+            if (game_state.ghost_y != land) {
+                fprintf(stderr, "action %llu: landing row %d, reference %d\n",
+                        (unsigned long long)i, game_state.ghost_y, land);
+                return 1;
+            }
+            uint32_t games = tetris_games;
+            int before = ref_lines;
+            tetris_action(action);
+            ref_lock(type, rot, x, land);
+            ref_check_line_clear();
+            lines += ref_lines - before;
+            if (tetris_games != games)
+                ref_reset(); // game over
+            pieces++;
+            steps = 0;
+            target_rot = -1;
+            if (!same_board(i) || !same_collisions(i))
+                return 1;
+            continue;
+        }
+
+        tetris_action(action);
+        if (action == ACTION_ROTATE || action == ACTION_ROTATE_CCW) {
+            if (ref_collides(game_state.current_shape_type, game_state.current_rotation,
+                             game_state.current_x, game_state.current_y)) {
+                fprintf(stderr, "action %llu: rotated into a collision\n", (unsigned long long)i);
+                return 1;
+            }
+            continue;
+        }
+        int dx = action == ACTION_LEFT ? -1 : action == ACTION_RIGHT ? 1 : 0;
+        int dy = action == ACTION_SOFT_DROP;
+        if (!ref_collides(type, rot, x + dx, y + dy)) {
+            x += dx;
+            y += dy;
+        }
+        if (game_state.current_x != x || game_state.current_y != y) {
+            fprintf(stderr, "action %llu: piece at (%d, %d), reference (%d, %d)\n",
+                    (unsigned long long)i, game_state.current_x, game_state.current_y, x, y);
+            return 1;
+        }
+    }
+
+    printf("%llu actions, %llu pieces, %llu lines: identical\n",
+           (unsigned long long)nb_actions, (unsigned long long)pieces, (unsigned long long)lines);
+    return 0;
+}
@@ -0,0 +1,220 @@
+/* Line clear benchmark, built natively with `make host`.
+ *
+ * Times check_line_clear() against the previous row-by-row version (shift the
+ * whole board above each full row, then retest the same row) on randomized
+ * boards, and checks that both leave the exact same board behind.
+ *
+ * Usage: line_clear_bench [-n boards] [-s seed]
+ *
+ * Each board has random garbage rows under a random height and a 4-row
+ * window, as left by a locking I piece, where 0 to 4 rows are completed.
+ *
+ * Both versions rescan the column heights after a clear, as the game needs
+ * them: the times include that rescan.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include "tetris.h"
+
+
+#define WINDOW 4
+#define NB_BOARDS 4096 // distinct boards, replayed round robin
+
+
+// Column heights from the occupancy rows, as update_col_heights() does
+static void col_heights(game_state_t *g)
+{
+    uint16_t seen = 0;
+    memset(g->col_height, 0, sizeof(g->col_height));
+    for (int y = 0; y < BOARD_HEIGHT && seen != BOARD_FULL_ROW; y++) {
+        uint16_t top = g->board_rows[y] & ~seen;
+        seen |= top;
+        for (int x = 0; top; x++, top >>= 1) {
+            if (top & 1) {
+                g->col_height[x] = BOARD_HEIGHT - y;
+            }
+        }
+    }
+}
+
+
+// Row-by-row clear as it was before the single-pass compaction
+static void check_line_clear_rowwise(int y_first, int y_last)
+{
+    int lines_cleared = 0;
+    if (y_first < 0) {
+        y_first = 0;
+    }
+    for (int y = y_last; y >= y_first; ) {
+        if (game_state.row_fill[y] == BOARD_WIDTH) {
+            memmove(&game_state.board_rows[1], &game_state.board_rows[0],
+                    y * sizeof(game_state.board_rows[0]));
+            memmove(&game_state.board_colors[1], &game_state.board_colors[0],
+                    y * sizeof(game_state.board_colors[0]));
+            memmove(&game_state.row_fill[1], &game_state.row_fill[0],
+                    y * sizeof(game_state.row_fill[0]));
+            game_state.board_rows[0] = 0;
+            memset(game_state.board_colors[0], 0, sizeof(game_state.board_colors[0]));
+            game_state.row_fill[0] = 0;
+            for (int d = 0; d <= y; d++) {
+                board_damage[d] = BOARD_FULL_ROW;
+            }
+            lines_cleared++;
+            y_first++;
+        } else {
+            y--;
+        }
+    }
+    if (lines_cleared > 0) {
+        col_heights(&game_state);
+        static int score_multiplier[] = {0, 40, 100, 300, 1200};
+        game_state.score += score_multiplier[lines_cleared] * (game_state.level + 1);
+        game_state.lines_cleared += lines_cleared;
+        game_state.level = game_state.lines_cleared / 10;
+    }
+}
+
+
+// Baseline: restoring the board is part of every timed run
+static void no_clear(int y_first, int y_last)
+{
+    (void)y_first;
+    (void)y_last;
+}
+
+
+typedef struct {
+    game_state_t state;
+    int y_first;
+    int full_rows;
+} board_t;
+
+static board_t boards[NB_BOARDS];
+
+
+static void set_cell(game_state_t *g, int x, int y, int color)
+{
+    g->board_rows[y] |= 1 << x;
+    g->board_colors[y][x] = color;
+    g->row_fill[y]++;
+}
+
+
+static void random_board(board_t *b, uint32_t *rng)
+{
+    game_state_t *g = &b->state;
+    memset(g, 0, sizeof(*g));
+
+    int height = WINDOW + tetris_rand(rng) % (BOARD_HEIGHT - WINDOW + 1);
+    b->y_first = BOARD_HEIGHT - height + tetris_rand(rng) % (height - WINDOW + 1);
+    b->full_rows = 0;
+
+    for (int y = BOARD_HEIGHT - height; y < BOARD_HEIGHT; y++) {
+        int in_window = y >= b->y_first && y < b->y_first + WINDOW;
+        if (in_window && (tetris_rand(rng) & 1)) {
+            for (int x = 0; x < BOARD_WIDTH; x++) {
+                set_cell(g, x, y, 1 + tetris_rand(rng) % NUM_SHAPES);
+            }
+            b->full_rows++;
+        } else {
+            // At least one hole so that the row never counts as full
+            int hole = tetris_rand(rng) % BOARD_WIDTH;
+            for (int x = 0; x < BOARD_WIDTH; x++) {
+                if (x != hole && (tetris_rand(rng) & 3)) {
+                    set_cell(g, x, y, 1 + tetris_rand(rng) % NUM_SHAPES);
+                }
+            }
+        }
+    }
+    col_heights(g);
+}
+
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static double run(void (*clear)(int, int), uint64_t nb_runs, uint32_t *checksum)
+{
+    uint32_t h = 2166136261u;
+    double start = now();
+    for (uint64_t i = 0; i < nb_runs; i++) {
+        const board_t *b = &boards[i % NB_BOARDS];
+        game_state = b->state;
+        clear(b->y_first, b->y_first + WINDOW - 1);
+        h = (h ^ game_state.board_rows[BOARD_HEIGHT - 1] ^ game_state.score) * 16777619u;
+    }
+    double elapsed = now() - start;
+    *checksum = h;
+    return elapsed;
+}
+
+
+int main(int argc, char **argv)
+{
+    uint64_t nb_runs = 10000000;
+    uint32_t seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+            case 'n': nb_runs = strtoull(optarg, NULL, 0); break;
+            case 's': seed = strtoul(optarg, NULL, 0);     break;
+            default:
+                fprintf(stderr, "Usage: %s [-n boards] [-s seed]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    uint32_t rng = seed ? seed : 1;
+    int histogram[WINDOW + 1] = {0};
+    for (int i = 0; i < NB_BOARDS; i++) {
+        random_board(&boards[i], &rng);
+        histogram[boards[i].full_rows]++;
+    }
+
+    // Both versions must leave the same board
+    for (int i = 0; i < NB_BOARDS; i++) {
+        const board_t *b = &boards[i];
+        game_state = b->state;
+        check_line_clear_rowwise(b->y_first, b->y_first + WINDOW - 1);
+        game_state_t expected = game_state;
+        game_state = b->state;
+        check_line_clear(b->y_first, b->y_first + WINDOW - 1);
+        if (memcmp(&expected, &game_state, sizeof(game_state))) {
+            fprintf(stderr, "board %d: results differ\n", i);
+            return 1;
+        }
+    }
+
+    printf("boards:     %d distinct, lines per board:", NB_BOARDS);
+    for (int i = 0; i <= WINDOW; i++) {
+        printf(" %d:%d", i, histogram[i]);
+    }
+    printf("\n");
+
+    uint32_t h_none, h_rowwise, h_compact;
+    double t_none = run(no_clear, nb_runs, &h_none);
+    double t_rowwise = run(check_line_clear_rowwise, nb_runs, &h_rowwise) - t_none;
+    double t_compact = run(check_line_clear, nb_runs, &h_compact) - t_none;
+
+    printf("board copy: %6.1f ns/board (subtracted below)\n", t_none * 1e9 / nb_runs);
+    printf("row-by-row: %6.1f ns/board\n", t_rowwise * 1e9 / nb_runs);
+    printf("compaction: %6.1f ns/board (x%.2f)\n", t_compact * 1e9 / nb_runs, t_rowwise / t_compact);
+    if (h_rowwise != h_compact) {
+        fprintf(stderr, "checksums differ\n");
+        return 1;
+    }
+
+    return 0;
+}
+
@@ -0,0 +1,442 @@
+/* Parallel lookahead solver, built natively with `make host`.
+ *
+ * For every piece, each reachable placement of the current piece (see ai.h)
+ * is a task: a beam search over the next pieces of the preview, keeping the
+ * best `beam` boards at each depth. Boards are produced by the game core
+ * itself (ai_apply() then hard_drop(), line clears and the next spawn), on a
+ * thread-local copy of the game state. The tasks are spread over the deques
+ * of a work-stealing pool: each worker pops its own tasks, then steals from
+ * the others once its deque is empty.
+ *
+ * The chosen placement is then played on the real game as key taps, one per
+ * simulation step, so the session can be recorded (-w) and played back by
+ * `tetris_sim -p` or by a REPLAY_PLAYBACK build on Harvey.
+ *
+ * The same game is played with 1, 2, 4... up to N threads, reporting nodes
+ * (placements scored) per second and the scaling efficiency. Every run must
+ * end with the same checksum: the result does not depend on the scheduling.
+ *
+ * Usage: solver [-n pieces] [-s seed] [-d depth] [-b beam] [-t threads] [-w replay]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "tetris.h"
+#include "replay.h"
+#include "ai.h"
+
+
+#define MAX_BEAM    64
+#define DEAD        (INT32_MIN / 2) // the search topped out
+#define RECORD_BUFFER_SIZE (16 << 20)
+
+static int depth = 2;       // preview pieces searched after the current one
+static int beam_width = 16;
+
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+////////////////////////////////// Beam search //////////////////////////////////
+
+typedef struct {
+    int parent;       // frontier board it was placed on
+    ai_move_t move;
+    int32_t value;    // lines cleared on the way + heuristic of the board
+} candidate_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    int tasks[AI_MAX_MOVES];
+    int head, tail;   // thieves take at head, the owner at tail
+} deque_t;
+
+typedef struct {
+    pthread_t thread;
+    deque_t deque;
+    uint64_t nodes;
+    uint64_t steals;
+    game_state_t frontier[2][MAX_BEAM];
+    candidate_t candidates[MAX_BEAM * AI_MAX_MOVES];
+} worker_t;
+
+static const game_state_t *root; // board the tasks search from, read-only
+
+
+static int compare_candidates(const void *a, const void *b)
+{
+    const candidate_t *x = a, *y = b;
+    if (x->value != y->value)
+        return x->value > y->value ? -1 : 1;
+    if (x->parent != y->parent)
+        return x->parent - y->parent;
+    if (x->move.rotation != y->move.rotation)
+        return x->move.rotation - y->move.rotation;
+    return x->move.x - y->move.x;
+}
+
+
+// Value of a placement of the current piece: the best board found `depth`
+// pieces later. Children are ranked by the score ai_list_moves() gives them,
+// only the `beam` best ones are played to get the next frontier.
+static int32_t search(worker_t *w, const ai_move_t *first)
+{
+    game_state = *root;
+    uint32_t games = tetris_games;
+    ai_apply(first);
+    if (tetris_games != games)
+        return DEAD;
+    if (depth == 0)
+        return first->score;
+
+    game_state_t *frontier = w->frontier[0];
+    game_state_t *next = w->frontier[1];
+    int n = 1;
+    frontier[0] = game_state;
+
+    for (int d = 0; ; d++) {
+        ai_move_t moves[AI_MAX_MOVES];
+        int nc = 0;
+        for (int i = 0; i < n; i++) {
+            game_state = frontier[i];
+            int32_t lines = (game_state.lines_cleared - root->lines_cleared) * ai_weights.lines;
+            int nm = ai_list_moves(moves);
+            for (int j = 0; j < nm; j++) {
+                w->candidates[nc].parent = i;
+                w->candidates[nc].move = moves[j];
+                w->candidates[nc].value = lines + moves[j].score;
+                nc++;
+            }
+        }
+        w->nodes += nc;
+        if (nc == 0)
+            return DEAD;
+        qsort(w->candidates, nc, sizeof(candidate_t), compare_candidates);
+        if (d == depth - 1)
+            return w->candidates[0].value;
+
+        int keep = nc < beam_width ? nc : beam_width;
+        int kept = 0;
+        for (int k = 0; k < keep; k++) {
+            game_state = frontier[w->candidates[k].parent];
+            games = tetris_games;
+            ai_apply(&w->candidates[k].move);
+            if (tetris_games == games)
+                next[kept++] = game_state;
+        }
+        if (kept == 0)
+            return DEAD;
+        game_state_t *t = frontier;
+        frontier = next;
+        next = t;
+        n = kept;
+    }
+}
+
+
+////////////////////////////// Work-stealing pool ///////////////////////////////
+
+static worker_t *workers;
+static int nb_workers;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static unsigned pool_generation;
+static int pool_quit;
+static atomic_int pool_pending;
+
+static ai_move_t job_moves[AI_MAX_MOVES];
+static int32_t job_values[AI_MAX_MOVES];
+
+
+// Own tasks last in first out, then the oldest task of another worker
+static int take_task(worker_t *w)
+{
+    int task = -1;
+    pthread_mutex_lock(&w->deque.lock);
+    if (w->deque.head < w->deque.tail)
+        task = w->deque.tasks[--w->deque.tail];
+    pthread_mutex_unlock(&w->deque.lock);
+    if (task >= 0)
+        return task;
+
+    int self = w - workers;
+    for (int k = 1; k < nb_workers && task < 0; k++) {
+        deque_t *victim = &workers[(self + k) % nb_workers].deque;
+        pthread_mutex_lock(&victim->lock);
+        if (victim->head < victim->tail)
+            task = victim->tasks[victim->head++];
+        pthread_mutex_unlock(&victim->lock);
+    }
+    if (task >= 0)
+        w->steals++;
+    return task;
+}
+
+
+// No task is added during a job: once every deque is empty, only the
+// searches already taken remain
+static void run_tasks(worker_t *w)
+{
+    int task;
+    while ((task = take_task(w)) >= 0) {
+        job_values[task] = search(w, &job_moves[task]);
+        if (atomic_fetch_sub(&pool_pending, 1) == 1) {
+            pthread_mutex_lock(&pool_lock);
+            pthread_cond_broadcast(&pool_done);
+            pthread_mutex_unlock(&pool_lock);
+        }
+    }
+}
+
+
+static void *worker_main(void *arg)
+{
+    worker_t *w = arg;
+    unsigned generation = 0;
+
+    pthread_mutex_lock(&pool_lock);
+    while (1) {
+        while (pool_generation == generation && !pool_quit)
+            pthread_cond_wait(&pool_wake, &pool_lock);
+        if (pool_quit)
+            break;
+        generation = pool_generation;
+        pthread_mutex_unlock(&pool_lock);
+        run_tasks(w);
+        pthread_mutex_lock(&pool_lock);
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return NULL;
+}
+
+
+static void pool_start(int threads)
+{
+    nb_workers = threads;
+    workers = calloc(threads, sizeof(worker_t));
+    pool_quit = 0;
+    pool_generation = 0;
+    for (int i = 0; i < threads; i++)
+        pthread_mutex_init(&workers[i].deque.lock, NULL);
+    // Worker 0 is the calling thread
+    for (int i = 1; i < threads; i++)
+        pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+}
+
+
+static void pool_stop()
+{
+    pthread_mutex_lock(&pool_lock);
+    pool_quit = 1;
+    pthread_cond_broadcast(&pool_wake);
+    pthread_mutex_unlock(&pool_lock);
+    for (int i = 1; i < nb_workers; i++)
+        pthread_join(workers[i].thread, NULL);
+    for (int i = 0; i < nb_workers; i++)
+        pthread_mutex_destroy(&workers[i].deque.lock);
+    free(workers);
+}
+
+
+// Search the n placements in job_moves, dealt round robin to the deques
+static void pool_run(int n)
+{
+    // Counted before any task is published: a worker still looking for work
+    // from the previous job may take one at once
+    atomic_store(&pool_pending, n);
+    for (int i = 0; i < nb_workers; i++) {
+        deque_t *d = &workers[i].deque;
+        pthread_mutex_lock(&d->lock);
+        d->head = d->tail = 0;
+        for (int t = i; t < n; t += nb_workers)
+            d->tasks[d->tail++] = t;
+        pthread_mutex_unlock(&d->lock);
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    pool_generation++;
+    pthread_cond_broadcast(&pool_wake);
+    pthread_mutex_unlock(&pool_lock);
+
+    run_tasks(&workers[0]);
+
+    pthread_mutex_lock(&pool_lock);
+    while (atomic_load(&pool_pending) > 0)
+        pthread_cond_wait(&pool_done, &pool_lock);
+    pthread_mutex_unlock(&pool_lock);
+}
+
+
+//////////////////////////////////// Game ///////////////////////////////////////
+
+static replay_writer_t recorder;
+static int recording;
+
+
+// One key tap per simulation step, as a player would
+static void tap(tetris_action_t action)
+{
+    tetris_press(action);
+    tetris_release(action);
+    if (recording) {
+        replay_write_event(&recorder, tetris_tick, action, 1);
+        replay_write_event(&recorder, tetris_tick, action, 0);
+    }
+    tetris_step();
+}
+
+
+static void play(const ai_move_t *move)
+{
+    int turns = (move->rotation - game_state.current_rotation) & 3;
+    if (turns == 3) {
+        tap(ACTION_ROTATE_CCW);
+    } else {
+        for (int i = 0; i < turns; i++)
+            tap(ACTION_ROTATE);
+    }
+    int dx = move->x - game_state.current_x;
+    for (int i = 0; i < abs(dx); i++)
+        tap(dx < 0 ? ACTION_LEFT : ACTION_RIGHT);
+    tap(ACTION_HARD_DROP);
+}
+
+
+typedef struct {
+    double time;
+    uint64_t nodes;
+    uint64_t steals;
+    uint32_t checksum;
+    uint32_t games;
+} run_result_t;
+
+
+static run_result_t run_game(int threads, uint32_t seed, uint64_t nb_pieces)
+{
+    run_result_t result = {0};
+    static game_state_t position;
+
+    tetris_init(seed);
+    pool_start(threads);
+    double start = now();
+    for (uint64_t piece = 0; piece < nb_pieces; piece++) {
+        int n = ai_list_moves(job_moves);
+        if (n == 0) {
+            tap(ACTION_HARD_DROP); // topped out
+            continue;
+        }
+        result.nodes += n;
+
+        // The searches run on the thread-local state, this thread's included
+        position = game_state;
+        uint32_t games = tetris_games;
+        root = &position;
+        pool_run(n);
+        game_state = position;
+        tetris_games = games;
+
+        int best = 0;
+        for (int i = 1; i < n; i++) {
+            if (job_values[i] > job_values[best])
+                best = i;
+        }
+        play(&job_moves[best]);
+    }
+    result.time = now() - start;
+    for (int i = 0; i < threads; i++) {
+        result.nodes += workers[i].nodes;
+        result.steals += workers[i].steals;
+    }
+    pool_stop();
+
+    result.checksum = tetris_checksum();
+    result.games = tetris_games;
+    return result;
+}
+
+
+int main(int argc, char **argv)
+{
+    uint64_t nb_pieces = 1000;
+    uint32_t seed = 1;
+    int max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *record_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:d:b:t:w:")) != -1) {
+        switch (opt) {
+            case 'n': nb_pieces = strtoull(optarg, NULL, 0); break;
+            case 's': seed = strtoul(optarg, NULL, 0);       break;
+            case 'd': depth = atoi(optarg);                  break;
+            case 'b': beam_width = atoi(optarg);             break;
+            case 't': max_threads = atoi(optarg);            break;
+            case 'w': record_path = optarg;                  break;
+            default:
+                fprintf(stderr, "Usage: %s [-n pieces] [-s seed] [-d depth] [-b beam] [-t threads] [-w replay]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (depth < 0 || depth > TETRIS_PREVIEW || beam_width < 1 || beam_width > MAX_BEAM || max_threads < 1) {
+        fprintf(stderr, "depth must be in [0, %d], beam in [1, %d], threads at least 1\n",
+                TETRIS_PREVIEW, MAX_BEAM);
+        return 1;
+    }
+
+    printf("%llu pieces, seed %u, depth %d, beam %d\n", (unsigned long long)nb_pieces, seed, depth, beam_width);
+    printf("threads      time (s)    nodes/sec   speedup  efficiency   steals  checksum\n");
+
+    run_result_t base = {0};
+    int status = 0;
+    for (int threads = 1; ; threads = threads * 2 < max_threads ? threads * 2 : max_threads) {
+        // The first run is the recorded one
+        if (threads == 1 && record_path) {
+            replay_writer_init(&recorder, malloc(RECORD_BUFFER_SIZE), RECORD_BUFFER_SIZE, seed);
+            recording = 1;
+        }
+        run_result_t r = run_game(threads, seed, nb_pieces);
+        if (threads == 1) {
+            base = r;
+            if (recording) {
+                if (!replay_write_end(&recorder, tetris_tick, tetris_checksum()))
+                    fprintf(stderr, "%s: replay truncated\n", record_path);
+                recording = 0;
+            }
+        }
+
+        double speedup = base.time / r.time;
+        printf("%7d  %12.3f  %11.0f  %8.2f  %9.0f%%  %7llu  %08x%s\n", threads, r.time,
+               r.nodes / r.time, speedup, speedup * 100 / threads,
+               (unsigned long long)r.steals, r.checksum,
+               r.checksum == base.checksum ? "" : " MISMATCH");
+        if (r.checksum != base.checksum)
+            status = 1;
+        if (threads == max_threads)
+            break;
+    }
+    printf("final:      score %d, lines %d, %u game overs\n",
+           game_state.score, game_state.lines_cleared, base.games);
+
+    if (record_path) {
+        FILE *f = fopen(record_path, "wb");
+        if (!f || fwrite(recorder.buf, 1, recorder.len, f) != recorder.len) {
+            perror(record_path);
+            return 1;
+        }
+        fclose(f);
+        printf("replay:     %s, %zu bytes\n", record_path, recorder.len);
+    }
+    return status;
+}
@@ -0,0 +1,259 @@
+/* Headless simulator of the game core, built natively with `make host`.
+ *
+ * Runs tetris_step() as fast as possible while replaying scripted input, then
+ * reports the simulation throughput in ticks per second and a checksum of the
+ * final game state, so that two builds can be compared on identical runs.
+ *
+ * Usage: tetris_sim [-n ticks] [-s seed] [-w replay] [-a] [script]
+ *        tetris_sim -p replay
+ *
+ * The script is a text file of "<tick> <action>" lines sorted by tick, where
+ * action is one of L (left), R (right), U (rotate clockwise), C (rotate
+ * counter-clockwise), D (soft drop) or H (hard drop). It is replayed in a loop,
+ * its ticks being relative to the start of each pass.
+ * Without a script, input is generated pseudo-randomly. The seed selects both
+ * the piece stream and the generated input.
+ *
+ * -a lets the autoplay AI (see ai.h) place every piece instead, and reports
+ * its search time. It cannot be combined with -w.
+ *
+ * -w records the session to a replay file (see replay.h), -p plays a replay
+ * back, from the host or from the target, and checks its final state.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include "tetris.h"
+#include "replay.h"
+#include "ai.h"
+
+
+typedef struct {
+    uint32_t tick;
+    tetris_action_t action;
+} script_event_t;
+
+static script_event_t *script;
+static size_t script_len;
+
+
+static int load_script(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    size_t cap = 256;
+    script = malloc(cap * sizeof(*script));
+    uint32_t tick;
+    char a;
+    while (fscanf(f, "%u %c", &tick, &a) == 2) {
+        tetris_action_t action;
+        switch (a) {
+            case 'L': action = ACTION_LEFT;       break;
+            case 'R': action = ACTION_RIGHT;      break;
+            case 'U': action = ACTION_ROTATE;     break;
+            case 'C': action = ACTION_ROTATE_CCW; break;
+            case 'D': action = ACTION_SOFT_DROP;  break;
+            case 'H': action = ACTION_HARD_DROP;  break;
+            default:
+                fprintf(stderr, "%s: unknown action '%c'\n", path, a);
+                fclose(f);
+                return -1;
+        }
+        if (script_len == cap) {
+            cap *= 2;
+            script = realloc(script, cap * sizeof(*script));
+        }
+        script[script_len].tick = tick;
+        script[script_len].action = action;
+        script_len++;
+    }
+    fclose(f);
+
+    if (script_len == 0) {
+        fprintf(stderr, "%s: empty script\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+#define RECORD_BUFFER_SIZE (16 << 20)
+
+static replay_writer_t recorder;
+static int recording;
+static uint64_t nb_events;
+
+
+static void feed(tetris_action_t action, int pressed)
+{
+    if (pressed)
+        tetris_press(action);
+    else
+        tetris_release(action);
+    if (recording)
+        replay_write_event(&recorder, tetris_tick, action, pressed);
+    nb_events++;
+}
+
+
+static uint8_t *load_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = malloc(*len ? *len : 1);
+    if (fread(buf, 1, *len, f) != *len) {
+        perror(path);
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    return buf;
+}
+
+
+// Re-run a recorded session and check that it ends in the recorded state
+static int playback(const char *path)
+{
+    size_t len;
+    uint8_t *buf = load_file(path, &len);
+    replay_reader_t player;
+    if (!buf)
+        return 1;
+    if (!replay_reader_init(&player, buf, len)) {
+        fprintf(stderr, "%s: not a replay\n", path);
+        return 1;
+    }
+
+    tetris_init(player.seed);
+    double start = now();
+    int status;
+    while ((status = replay_apply(&player, tetris_tick)) > 0)
+        tetris_step();
+    double elapsed = now() - start;
+
+    if (status < 0) {
+        fprintf(stderr, "%s: truncated or corrupt at tick %u\n", path, tetris_tick);
+        return 1;
+    }
+    printf("ticks:      %u\n", tetris_tick);
+    printf("time:       %.3f s (%.1f ns/tick)\n", elapsed, elapsed * 1e9 / (tetris_tick ? tetris_tick : 1));
+    printf("final:      score %d, lines %d, level %d\n", game_state.score, game_state.lines_cleared, game_state.level);
+    printf("checksum:   %08x, recorded %08x: %s\n", tetris_checksum(), player.next.checksum,
+           tetris_checksum() == player.next.checksum ? "match" : "MISMATCH");
+    free(buf);
+    return tetris_checksum() != player.next.checksum;
+}
+
+
+int main(int argc, char **argv)
+{
+    uint64_t nb_ticks = 10000000;
+    uint32_t seed = 1;
+    const char *record_path = NULL;
+    int autoplay = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:w:p:a")) != -1) {
+        switch (opt) {
+            case 'n': nb_ticks = strtoull(optarg, NULL, 0); break;
+            case 's': seed = strtoul(optarg, NULL, 0);      break;
+            case 'w': record_path = optarg;                 break;
+            case 'p': return playback(optarg);
+            case 'a': autoplay = 1;                         break;
+            default:
+                fprintf(stderr, "Usage: %s [-n ticks] [-s seed] [-w replay] [-a] [script]\n"
+                                "       %s -p replay\n", argv[0], argv[0]);
+                return 1;
+        }
+    }
+    if (autoplay && record_path) {
+        // The AI places pieces directly, a replay only holds the actions
+        fprintf(stderr, "-a cannot be recorded with -w\n");
+        return 1;
+    }
+    if (optind < argc && load_script(argv[optind]) < 0)
+        return 1;
+
+    tetris_init(seed);
+    if (record_path) {
+        replay_writer_init(&recorder, malloc(RECORD_BUFFER_SIZE), RECORD_BUFFER_SIZE, seed);
+        recording = 1;
+    }
+
+    uint32_t rng = ~seed ? ~seed : 1; // input stream, distinct from the pieces
+    size_t next = 0;
+    uint32_t pass_start = 0;
+    uint64_t nb_moves = 0;
+    double ai_time = 0;
+
+    double start = now();
+    for (uint64_t tick = 0; tick < nb_ticks; tick++) {
+        if (autoplay) {
+            double ai_start = now();
+            ai_play();
+            ai_time += now() - ai_start;
+            nb_moves++;
+        } else if (script) {
+            // Each scripted action is a key tap
+            while (next < script_len && script[next].tick <= tick - pass_start) {
+                feed(script[next].action, 1);
+                feed(script[next].action, 0);
+                next++;
+            }
+            if (next == script_len) {
+                next = 0;
+                pass_start = tick + 1;
+            }
+        } else if ((tetris_rand(&rng) & 7) == 0) {
+            // Random key goes down, or up if it was held
+            tetris_action_t action = tetris_rand(&rng) % NUM_ACTIONS;
+            feed(action, !(game_state.keys.held & ACTION_BIT(action)));
+        }
+        tetris_step();
+    }
+    double elapsed = now() - start;
+
+    printf("ticks:      %llu (%llu key events)\n", (unsigned long long)nb_ticks, (unsigned long long)nb_events);
+    printf("time:       %.3f s\n", elapsed);
+    printf("ticks/sec:  %.0f\n", nb_ticks / elapsed);
+    printf("final:      score %d, lines %d, level %d\n", game_state.score, game_state.lines_cleared, game_state.level);
+    printf("checksum:   %08x\n", tetris_checksum());
+    if (autoplay)
+        printf("ai:         %llu moves, %.0f ns/move\n", (unsigned long long)nb_moves, ai_time * 1e9 / nb_moves);
+
+    if (record_path) {
+        if (!replay_write_end(&recorder, tetris_tick, tetris_checksum()))
+            fprintf(stderr, "%s: replay truncated\n", record_path);
+        FILE *f = fopen(record_path, "wb");
+        if (!f || fwrite(recorder.buf, 1, recorder.len, f) != recorder.len) {
+            perror(record_path);
+            return 1;
+        }
+        fclose(f);
+        printf("replay:     %s, %zu bytes\n", record_path, recorder.len);
+    }
+
+    return 0;
+}
@@ -0,0 +1,195 @@
+/* Batch tournament of the autoplay heuristics, built natively with `make host`.
+ *
+ * Plays every weight set on every seed, one whole game per thread at a time:
+ * the game state and the weights are thread-local (TETRIS_THREADS), so the
+ * games share nothing but the index of the next game to play. A game ends at
+ * its first game over or after -n pieces. The AI places pieces directly, no
+ * simulation step runs in between.
+ *
+ * One CSV line per game is written to stdout (or -o), with the pieces, lines,
+ * score and pieces per second of the game. A summary per weight set and the
+ * overall throughput go to stderr.
+ *
+ * Usage: tournament [-g games] [-s first_seed] [-n max_pieces] [-t threads]
+ *                   [-o csv] [-W lines,height,holes,bumpiness]...
+ * Without -W, the default weights of ai.c play alone.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "tetris.h"
+#include "ai.h"
+
+
+#define MAX_WEIGHT_SETS 32
+
+typedef struct {
+    int set;          // index in weight_sets
+    uint32_t seed;
+    uint64_t pieces;
+    int lines;
+    int score;
+    int game_over;
+    double time;
+} game_result_t;
+
+static ai_weights_t weight_sets[MAX_WEIGHT_SETS];
+static int nb_weight_sets;
+static int nb_seeds = 100;
+static uint32_t first_seed = 1;
+static uint64_t max_pieces = 100000;
+
+static game_result_t *results;
+static int nb_games;
+static atomic_int next_game;
+
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void play_game(game_result_t *r)
+{
+    ai_weights = weight_sets[r->set];
+    tetris_init(r->seed);
+
+    // A game over resets the board and the counters: the result keeps them
+    // as they were before the last piece
+    double start = now();
+    uint64_t pieces = 0;
+    while (pieces < max_pieces && tetris_games == 0) {
+        r->lines = game_state.lines_cleared;
+        r->score = game_state.score;
+        ai_play();
+        pieces++;
+    }
+    r->time = now() - start;
+    r->game_over = tetris_games > 0;
+    r->pieces = pieces;
+    if (!r->game_over) {
+        r->lines = game_state.lines_cleared;
+        r->score = game_state.score;
+    }
+}
+
+
+static void *worker_main(void *arg)
+{
+    (void)arg;
+    int i;
+    while ((i = atomic_fetch_add(&next_game, 1)) < nb_games)
+        play_game(&results[i]);
+    return NULL;
+}
+
+
+static int parse_weights(const char *arg, ai_weights_t *w)
+{
+    return sscanf(arg, "%d,%d,%d,%d", &w->lines, &w->height, &w->holes, &w->bumpiness) == 4;
+}
+
+
+int main(int argc, char **argv)
+{
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *csv_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "g:s:n:t:o:W:")) != -1) {
+        switch (opt) {
+            case 'g': nb_seeds = atoi(optarg);                 break;
+            case 's': first_seed = strtoul(optarg, NULL, 0);   break;
+            case 'n': max_pieces = strtoull(optarg, NULL, 0);  break;
+            case 't': threads = atoi(optarg);                  break;
+            case 'o': csv_path = optarg;                       break;
+            case 'W':
+                if (nb_weight_sets == MAX_WEIGHT_SETS || !parse_weights(optarg, &weight_sets[nb_weight_sets])) {
+                    fprintf(stderr, "bad or too many weight sets: %s\n", optarg);
+                    return 1;
+                }
+                nb_weight_sets++;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-g games] [-s first_seed] [-n max_pieces] [-t threads]\n"
+                                "       [-o csv] [-W lines,height,holes,bumpiness]...\n", argv[0]);
+                return 1;
+        }
+    }
+    if (nb_weight_sets == 0)
+        weight_sets[nb_weight_sets++] = ai_weights;
+    if (threads < 1 || nb_seeds < 1) {
+        fprintf(stderr, "threads and games must be at least 1\n");
+        return 1;
+    }
+
+    FILE *csv = stdout;
+    if (csv_path && !(csv = fopen(csv_path, "w"))) {
+        perror(csv_path);
+        return 1;
+    }
+
+    nb_games = nb_weight_sets * nb_seeds;
+    results = calloc(nb_games, sizeof(game_result_t));
+    for (int i = 0; i < nb_games; i++) {
+        results[i].set = i / nb_seeds;
+        results[i].seed = first_seed + i % nb_seeds;
+    }
+
+    pthread_t *pool = malloc(threads * sizeof(pthread_t));
+    double start = now();
+    for (int i = 0; i < threads; i++)
+        pthread_create(&pool[i], NULL, worker_main, NULL);
+    for (int i = 0; i < threads; i++)
+        pthread_join(pool[i], NULL);
+    double elapsed = now() - start;
+    free(pool);
+
+    fprintf(csv, "set,lines_w,height_w,holes_w,bumpiness_w,seed,pieces,lines,score,game_over,seconds,pieces_per_sec\n");
+    for (int i = 0; i < nb_games; i++) {
+        const game_result_t *r = &results[i];
+        const ai_weights_t *w = &weight_sets[r->set];
+        fprintf(csv, "%d,%d,%d,%d,%d,%u,%llu,%d,%d,%d,%.6f,%.0f\n", r->set,
+                w->lines, w->height, w->holes, w->bumpiness, r->seed,
+                (unsigned long long)r->pieces, r->lines, r->score, r->game_over,
+                r->time, r->pieces / r->time);
+    }
+    if (csv != stdout)
+        fclose(csv);
+
+    // Per set summary: a game lost early says more about the weights than the
+    // lines of the games that reached the piece limit
+    uint64_t total_pieces = 0;
+    double total_time = 0;
+    for (int s = 0; s < nb_weight_sets; s++) {
+        uint64_t pieces = 0;
+        double lines = 0, score = 0;
+        int lost = 0;
+        for (int i = s * nb_seeds; i < (s + 1) * nb_seeds; i++) {
+            pieces += results[i].pieces;
+            lines += results[i].lines;
+            score += results[i].score;
+            lost += results[i].game_over;
+            total_time += results[i].time;
+        }
+        total_pieces += pieces;
+        const ai_weights_t *w = &weight_sets[s];
+        fprintf(stderr, "set %d (%d,%d,%d,%d): %d/%d games lost, %.0f pieces, %.1f lines, %.0f score on average\n",
+                s, w->lines, w->height, w->holes, w->bumpiness, lost, nb_seeds,
+                (double)pieces / nb_seeds, lines / nb_seeds, score / nb_seeds);
+    }
+    fprintf(stderr, "%d games on %d threads in %.3f s: %.0f pieces/sec, %.0f per thread, %.0f%% parallel\n",
+            nb_games, threads, elapsed, total_pieces / elapsed, total_pieces / total_time,
+            total_time * 100 / (elapsed * threads));
+    free(results);
+    return 0;
+}
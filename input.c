@@ -0,0 +1,45 @@
+#include "input.h"
+
+volatile input_stats_t input_stats;
+
+static input_event_t     input_ring[INPUT_RING_LEN];
+static volatile uint32_t input_head = 0; // written by the producer only
+static volatile uint32_t input_tail = 0; // written by the consumer only
+
+// Compiler barrier: on the single Mini-RISC hart, this is enough to order the
+// event payload accesses with respect to the index update.
+#define input_barrier() __asm__ __volatile__("" ::: "memory")
+
+int input_push(uint16_t key_code, uint8_t pressed, uint64_t timestamp) {
+    uint32_t head = input_head;
+
+    if (head - input_tail >= INPUT_RING_LEN) {
+        input_stats.overflows++;
+        return 0;
+    }
+
+    input_event_t *e = &input_ring[head & (INPUT_RING_LEN - 1)];
+    e->timestamp = timestamp;
+    e->key_code  = key_code;
+    e->pressed   = pressed;
+    input_barrier();
+    input_head = head + 1;
+    input_stats.events++;
+
+    return 1;
+}
+
+int input_pop(input_event_t *event) {
+    uint32_t tail = input_tail;
+
+    if (tail == input_head) {
+        return 0;
+    }
+
+    input_barrier();
+    *event = input_ring[tail & (INPUT_RING_LEN - 1)];
+    input_barrier();
+    input_tail = tail + 1;
+
+    return 1;
+}
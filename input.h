@@ -0,0 +1,37 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdint.h>
+
+/* Keyboard events are captured by keyboard_interrupt_handler and consumed by
+ * the game tick through a lock-free ring. There is a single producer (the ISR)
+ * and a single consumer (the game loop): each side only ever writes its own
+ * index, so no critical section is needed on either side.
+ */
+
+#define INPUT_RING_LEN 32 // must be a power of two
+
+typedef struct {
+    uint64_t timestamp; // RTC->NSEC when the event was read from the FIFO
+    uint16_t key_code;
+    uint8_t  pressed;
+} input_event_t;
+
+typedef struct {
+    uint32_t isr_count;
+    uint32_t isr_max_instructions; // longest ISR, in instructions retired
+    uint64_t isr_instructions;     // total instructions retired in the ISR
+    uint32_t events;               // events pushed into the ring
+    uint32_t overflows;            // events dropped because the ring was full
+    uint32_t repeats;              // host key repeats ignored by the ISR
+} input_stats_t;
+
+extern volatile input_stats_t input_stats;
+
+// Producer side, called from the keyboard ISR. Returns 0 if the ring is full.
+int input_push(uint16_t key_code, uint8_t pressed, uint64_t timestamp);
+
+// Consumer side. Returns 0 when there is no pending event.
+int input_pop(input_event_t *event);
+
+#endif /* INPUT_H */
@@ -1,79 +1,65 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include "minirisc.h"
 #include "uart.h"
 #include "FreeRTOS.h"
 #include "task.h"
+#include "semphr.h"
 #include "harvey_platform.h"
 #include "xprintf.h"
-//////////////////////////
-#define SCREEN_WIDTH  640
-#define SCREEN_HEIGHT 480
+#include "log.h"
+#include "input.h"
+#include "raster.h"
+#include "font.h"
+#include "tetris.h"
+#include "replay.h"
+#include "ai.h"
 /////////////////////////
-#define NUM_SHAPES 7
-/*The board may be any size, although the standard Tetris board is 10 wide and 20 high*/
-#define BOARD_WIDTH 10
-#define BOARD_HEIGHT 20
-#define SQUARE_SIZE 20
+#define SQUARE_SIZE RASTER_TILE_SIZE
+#define GRID_COLOR 0xFF333333
 ///////////////////
-static uint32_t frame_buffer[SCREEN_WIDTH * SCREEN_HEIGHT];// 640x480 screen res 
+// Double buffering: the video controller scans frame_buffers[front_buffer] out
+// while the renderer draws into the other one (frame_buffer). The flip of
+// VIDEO->DMA_ADDR is done in video_interrupt_handler, at vblank.
+static uint32_t frame_buffers[2][SCREEN_WIDTH * SCREEN_HEIGHT];// 640x480 screen res 
+static uint32_t *frame_buffer = frame_buffers[1]; // back buffer, being drawn
+static volatile int front_buffer = 0;
+static volatile int flip_pending = 0;  // back buffer complete, to show at next vblank
+static volatile int render_busy = 0;   // renderer is drawing a frame
+static volatile uint32_t missed_vblanks = 0; // vblanks reached while a frame was still being drawn
 volatile uint32_t color = 0x00ff0000;
 
-//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// Tetromino shapes with 4 rotations for each // 1 cte color for each 
-int shapes[NUM_SHAPES][4][4][2] = {
-    // I-shape (4 rotations)
-    {
-        {{0,0}, {1,0}, {2,0}, {3,0}},
-        {{1,0}, {1,1}, {1,2}, {1,3}},
-        {{0,1}, {1,1}, {2,1}, {3,1}},
-        {{2,0}, {2,1}, {2,2}, {2,3}}
-    },
-    // O-shape (pas de rotation)
-    {
-        {{0,0}, {1,0}, {0,1}, {1,1}},
-        {{0,0}, {1,0}, {0,1}, {1,1}},
-        {{0,0}, {1,0}, {0,1}, {1,1}},
-        {{0,0}, {1,0}, {0,1}, {1,1}}
-    },
-    // T-shape (4 rotations)
-    {
-        {{1,0}, {0,1}, {1,1}, {2,1}},
-        {{1,0}, {1,1}, {2,1}, {1,2}},
-        {{0,1}, {1,1}, {2,1}, {1,2}},
-        {{1,0}, {0,1}, {1,1}, {1,2}}
-    },
-    // L-shape (4 rotations)
-    {
-        {{0,0}, {0,1}, {0,2}, {1,2}},
-        {{0,1}, {1,1}, {2,1}, {2,0}},
-        {{1,0}, {2,0}, {2,1}, {2,2}},
-        {{0,2}, {1,2}, {2,2}, {2,1}}
-    },
-    // Reverse L-shape
-    {
-        {{1,0}, {1,1}, {1,2}, {0,2}},
-        {{0,0}, {0,1}, {1,1}, {2,1}},
-        {{1,0}, {2,0}, {1,1}, {1,2}},
-        {{0,1}, {1,1}, {2,1}, {2,2}}
-    },
-    // S-shape
-    {
-        {{1,0}, {2,0}, {0,1}, {1,1}},
-        {{0,0}, {0,1}, {1,1}, {1,2}},
-        {{1,0}, {2,0}, {0,1}, {1,1}},
-        {{0,0}, {0,1}, {1,1}, {1,2}}
-    },
-    // Z-shape
-    {
-        {{0,0}, {1,0}, {1,1}, {2,1}},
-        {{1,0}, {0,1}, {1,1}, {0,2}},
-        {{0,0}, {1,0}, {1,1}, {2,1}},
-        {{1,0}, {0,1}, {1,1}, {0,2}}
-    }
-};
+// Cells to repaint in each buffer: the damage reported by the game core
+// (board_damage) is collected into both sets, as a change must reach both
+// buffers. Only those cells are repainted on refresh.
+static uint16_t dirty_cells[2][BOARD_HEIGHT];
+
+// HUD panel right of the board: labels are part of the background layer, the
+// values are redrawn in a buffer only when they differ from what that buffer
+// shows (hud_drawn, -1 when never drawn).
+#define HUD_X          ((BOARD_WIDTH + 2) * SQUARE_SIZE)
+#define HUD_WIDTH      (8 * SQUARE_SIZE)
+#define HUD_LINE       (FONT_CHAR_HEIGHT + 8)
+#define HUD_TEXT_COLOR 0xFFFFFFFF
+#define HUD_VALUE_LEN  10 // characters, the value is padded so that it covers the previous one
+
+typedef struct {
+    int score;
+    int level;
+    int lines;
+    int next;
+} hud_values_t;
+
+static hud_values_t hud_drawn[2] = {{-1, -1, -1, -1}, {-1, -1, -1, -1}};
+
+// Render statistics, to measure the savings under Harvey
+#define RENDER_STATS_PERIOD 60 // frames between two reports
+static uint64_t total_pixels_written;
+static uint32_t frames_drawn;
 
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Shape colors for variety
 uint32_t shape_colors[NUM_SHAPES] = {
     0xFF00FFFF,  // Cyan for I
@@ -85,317 +71,648 @@ uint32_t shape_colors[NUM_SHAPES] = {
     0xFFFF0000   // Red for Z
 };
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// Game state structure
-struct {
-    int board[BOARD_WIDTH][BOARD_HEIGHT]; // size standart de tetris 
-    int current_shape[4][2]; 
-    int current_shape_type;
-    int current_rotation;
-    int current_x, current_y;
-    int score;
-    int level;
-    int lines_cleared;
-} game_state;
+// Draw a grid for the Tetris board
+void draw_board_grid() {
+    for (int y = 0; y <= BOARD_HEIGHT; y++) {
+        raster_hline(frame_buffer, 0, y * SQUARE_SIZE, SCREEN_WIDTH, GRID_COLOR);
+    }
+    
+    // Vertical lines are drawn row by row rather than down each column
+    raster_vlines(frame_buffer, 0, SQUARE_SIZE, BOARD_WIDTH + 1, 0, SCREEN_HEIGHT, GRID_COLOR);
+}
+
+// Cell sprite cache, indexed like board_colors: tile 0 is the empty cell as it
+// appears in the background layer (black with the grid lines on its top and
+// left edges), tile t + 1 is a block of shape t.
+#define CELL_BEVEL 2 // width of the light/dark bevel of the blocks, 0 for flat blocks
+static uint32_t cell_tiles[NUM_SHAPES + 1][RASTER_TILE_PIXELS] __attribute__((aligned(16)));
+// Ghost of the falling piece on its landing row: the empty cell with a dark
+// outline in the color of the shape
+static uint32_t ghost_tiles[NUM_SHAPES][RASTER_TILE_PIXELS] __attribute__((aligned(16)));
+
+static uint32_t shade_color(uint32_t c, int lighter) {
+    uint32_t r = (c >> 16) & 0xff, g = (c >> 8) & 0xff, b = c & 0xff;
+    if (lighter) {
+        r += (255 - r) / 2; g += (255 - g) / 2; b += (255 - b) / 2;
+    } else {
+        r /= 2; g /= 2; b /= 2;
+    }
+    return (c & 0xff000000) | (r << 16) | (g << 8) | b;
+}
+
+void build_cell_tiles() {
+    for (int t = 0; t < NUM_SHAPES; t++) {
+        uint32_t *tile = cell_tiles[t + 1];
+        uint32_t light = shade_color(shape_colors[t], 1);
+        uint32_t dark  = shade_color(shape_colors[t], 0);
+        for (int y = 0; y < SQUARE_SIZE; y++) {
+            for (int x = 0; x < SQUARE_SIZE; x++) {
+                uint32_t c = shape_colors[t];
+                if (x < CELL_BEVEL && x < SQUARE_SIZE - y) {
+                    c = light; // left edge
+                } else if (y < CELL_BEVEL && y < SQUARE_SIZE - x) {
+                    c = light; // top edge
+                } else if (x >= SQUARE_SIZE - CELL_BEVEL || y >= SQUARE_SIZE - CELL_BEVEL) {
+                    c = dark;  // right and bottom edges
+                }
+                tile[y * SQUARE_SIZE + x] = c;
+            }
+        }
+        
+        // Ghost: outline drawn inside the grid lines of the empty cell
+        uint32_t *ghost = ghost_tiles[t];
+        memcpy(ghost, cell_tiles[0], sizeof(ghost_tiles[t]));
+        for (int i = 2; i < SQUARE_SIZE - 1; i++) {
+            ghost[2 * SQUARE_SIZE + i] = dark;
+            ghost[(SQUARE_SIZE - 2) * SQUARE_SIZE + i] = dark;
+            ghost[i * SQUARE_SIZE + 2] = dark;
+            ghost[i * SQUARE_SIZE + SQUARE_SIZE - 2] = dark;
+        }
+    }
+}
+
+// HUD layout: label on one line, value on the next
+#define HUD_SCORE_Y (1 * SQUARE_SIZE)
+#define HUD_LEVEL_Y (HUD_SCORE_Y + 3 * HUD_LINE)
+#define HUD_LINES_Y (HUD_LEVEL_Y + 3 * HUD_LINE)
+#define HUD_NEXT_Y  (HUD_LINES_Y + 3 * HUD_LINE)
+
+void draw_hud_background() {
+    raster_fill_rect(frame_buffer, HUD_X, 0, HUD_WIDTH, BOARD_HEIGHT * SQUARE_SIZE + 1, 0);
+    font_draw_string(frame_buffer, HUD_X, HUD_SCORE_Y, "SCORE", HUD_TEXT_COLOR, 0);
+    font_draw_string(frame_buffer, HUD_X, HUD_LEVEL_Y, "LEVEL", HUD_TEXT_COLOR, 0);
+    font_draw_string(frame_buffer, HUD_X, HUD_LINES_Y, "LINES", HUD_TEXT_COLOR, 0);
+    font_draw_string(frame_buffer, HUD_X, HUD_NEXT_Y,  "NEXT",  HUD_TEXT_COLOR, 0);
+}
+
+static void draw_hud_value(int y, int value) {
+    char text[16];
+    xsprintf(text, "%-*d", HUD_VALUE_LEN, value);
+    font_draw_string(frame_buffer, HUD_X, y + HUD_LINE, text, HUD_TEXT_COLOR, 0);
+}
+
+// Next piece, in its spawn rotation, on a 4x4 cell area
+static void draw_hud_next(int type) {
+    int y = HUD_NEXT_Y + HUD_LINE;
+    raster_fill_rect(frame_buffer, HUD_X, y, 4 * SQUARE_SIZE, 4 * SQUARE_SIZE, 0);
+    for (int i = 0; i < 4; i++) {
+        raster_blit_tile(frame_buffer, HUD_X + shapes[type][0][i][0] * SQUARE_SIZE,
+                         y + shapes[type][0][i][1] * SQUARE_SIZE, cell_tiles[type + 1]);
+    }
+}
 
-//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void init_video()
 {
-    memset(frame_buffer, 0, sizeof(frame_buffer)); // clear frame buffer to black
+    raster_init();
+    
+#ifdef RASTER_BENCHMARK
+    raster_benchmark(frame_buffers[0]);
+#endif
+    
+    // The background layer (black screen and grid) is drawn once into both
+    // buffers and never cleared: the renderer only ever repaints board cells.
+    for (int i = 0; i < 2; i++) {
+        frame_buffer = frame_buffers[i];
+        raster_fill_span(frame_buffer, SCREEN_WIDTH * SCREEN_HEIGHT, 0);
+        draw_board_grid();
+        draw_hud_background();
+    }
+    frame_buffer = frame_buffers[1 - front_buffer];
+    raster_copy_rect(cell_tiles[0], SQUARE_SIZE, &RASTER_PIXEL(frame_buffer, 0, 0), SCREEN_WIDTH,
+                     SQUARE_SIZE, SQUARE_SIZE);
+    build_cell_tiles();
+    raster_pixels_written = 0;
+    
     VIDEO->WIDTH  = SCREEN_WIDTH;
     VIDEO->HEIGHT = SCREEN_HEIGHT;
-    VIDEO->DMA_ADDR = frame_buffer;
+    VIDEO->DMA_ADDR = frame_buffers[front_buffer];
     VIDEO->CR = VIDEO_CR_IE | VIDEO_CR_EN;
 }
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-void draw_square(int x, int y, int width, uint32_t color)
+// Task pipeline: the ISRs only hand work off with task notifications.
+//   input  (highest) : applies the key events queued by the keyboard ISR
+//   sim              : fixed-step gravity (line clears happen on lock)
+//   render           : repaints the dirty cells on each video refresh
+//   stats            : periodic per-task run-time report
+//   log    (lowest)  : flushes the log ring to the UART (support/log.c)
+#define INPUT_TASK_PRIORITY  (tskIDLE_PRIORITY + 5)
+#define SIM_TASK_PRIORITY    (tskIDLE_PRIORITY + 4)
+#define RENDER_TASK_PRIORITY (tskIDLE_PRIORITY + 3)
+#define STATS_TASK_PRIORITY  (tskIDLE_PRIORITY + 2)
+#define LOG_TASK_PRIORITY    (tskIDLE_PRIORITY + 1)
+
+#define STATS_PERIOD_MS     5000
+
+static TaskHandle_t input_task_handle;
+static TaskHandle_t sim_task_handle;
+static TaskHandle_t render_task_handle;
+static TaskHandle_t stats_task_handle;
+static SemaphoreHandle_t game_mutex; // serializes the tasks that touch game_state
+
+void video_interrupt_handler()
 {
-    if (x >= SCREEN_WIDTH || y >= SCREEN_HEIGHT) {
-        return;
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    VIDEO->SR = 0;
+    if (flip_pending) {
+        front_buffer = 1 - front_buffer;
+        VIDEO->DMA_ADDR = frame_buffers[front_buffer];
+        flip_pending = 0;
+    } else if (render_busy) {
+        missed_vblanks++;
     }
-    int i, j;
-    int x_start = x < 0 ? 0 : x; // si x plus petit que 0 x_start = 0 sinon x=x 
-    int y_start = y < 0 ? 0 : y;//..
-    int x_end = x + width;
-    int y_end = y + width;
-    if (x_end > SCREEN_WIDTH) {
-        x_end = SCREEN_WIDTH;
+    vTaskNotifyGiveFromISR(render_task_handle, &xHigherPriorityTaskWoken);
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+// Only queue the raw events here: the game state is updated by the game tick.
+// Host key repeats are dropped, held keys are repeated by the simulation.
+void keyboard_interrupt_handler()
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    uint64_t start = minirisc_nb_instruction_retired();
+    uint32_t kdata;
+    int queued = 0;
+    while (KEYBOARD->SR & KEYBOARD_SR_FIFO_NOT_EMPTY) {
+        kdata = KEYBOARD->DATA;
+        if (kdata & KEYBOARD_DATA_REPEAT) {
+            input_stats.repeats++;
+            continue;
+        }
+        queued |= input_push(KEYBOARD_KEY_CODE(kdata),
+                             (kdata & KEYBOARD_DATA_PRESSED) != 0, RTC->NSEC);
     }
-    if (y_end > SCREEN_HEIGHT) {
-        y_end = SCREEN_HEIGHT;
+    uint32_t duration = (uint32_t)(minirisc_nb_instruction_retired() - start);
+    input_stats.isr_count++;
+    input_stats.isr_instructions += duration;
+    if (duration > input_stats.isr_max_instructions) {
+        input_stats.isr_max_instructions = duration;
     }
-    for (j = y_start; j < y_end; j++) {
-        for (i = x_start; i < x_end; i++) {
-            frame_buffer[j*SCREEN_WIDTH + i] = color;
-        }
+    if (queued) {
+        vTaskNotifyGiveFromISR(input_task_handle, &xHigherPriorityTaskWoken);
     }
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
 
-// Draw a grid for the Tetris board
-void draw_board_grid() {
-    for (int y = 0; y <= BOARD_HEIGHT; y++) {
-        int screen_y = y * SQUARE_SIZE;
-        for (int x = 0; x < SCREEN_WIDTH; x++) {
-            frame_buffer[screen_y * SCREEN_WIDTH + x] = 0xFF333333;
-        }
+// Session replays (see replay.h). Every session is recorded in RAM and saved
+// when quitting: to the BLKDEV disk from sector 0, or as raw bytes on the UART
+// when built with -DREPLAY_UART. Built with -DREPLAY_PLAYBACK, the replay is
+// read back from the disk at boot and its events are fed to the game at the
+// recorded ticks instead of the keyboard.
+#define REPLAY_BUFFER_SIZE (32 * 1024)
+#define BLKDEV_SECTOR_SIZE 512
+
+static uint8_t replay_buffer[REPLAY_BUFFER_SIZE] __attribute__((aligned(4)));
+static replay_writer_t recorder;
+#ifdef REPLAY_PLAYBACK
+static replay_reader_t player;
+static int playing;
+#endif
+
+// Simulation and render time, from RTC->NSEC
+static uint64_t sim_ns;
+static uint64_t render_ns;
+static uint32_t render_frames;
+
+static int blkdev_transfer(uint32_t cmd, void *buffer, uint32_t nb_sectors) {
+    BLKDEV->DMA_ADDR = buffer;
+    BLKDEV->SECTOR_INDEX = 0;
+    BLKDEV->NB_SECTORS = nb_sectors;
+    BLKDEV->CR = cmd;
+    while (!(BLKDEV->SR & (BLKDEV_SR_DONE | BLKDEV_SR_ERROR)));
+    return !(BLKDEV->SR & BLKDEV_SR_ERROR);
+}
+
+void replay_save() {
+    if (!replay_write_end(&recorder, tetris_tick, tetris_checksum())) {
+        log_warning("replay: buffer full, recording truncated\n");
     }
-    
-    for (int x = 0; x <= BOARD_WIDTH; x++) {
-        int screen_x = x * SQUARE_SIZE;
-        for (int y = 0; y < SCREEN_HEIGHT; y++) {
-            frame_buffer[y * SCREEN_WIDTH + screen_x] = 0xFF333333;
-        }
+#ifdef REPLAY_UART
+    // Raw bytes: no log span may be sent in the middle of them, and the
+    // header must come out before the data
+    char header[48];
+    log_suspend();
+    log_flush();
+    xsprintf(header, "replay: %u bytes follow\n", (uint32_t)recorder.len);
+    uart_write(header, strlen(header));
+    uart_write((const char *)recorder.buf, recorder.len);
+    uart_flush();
+    log_resume();
+#else
+    memset(replay_buffer + recorder.len, 0, REPLAY_BUFFER_SIZE - recorder.len);
+    uint32_t nb_sectors = (recorder.len + BLKDEV_SECTOR_SIZE - 1) / BLKDEV_SECTOR_SIZE;
+    if (blkdev_transfer(BLKDEV_CR_WR, replay_buffer, nb_sectors)) {
+        log_info("replay: %u bytes saved to disk\n", (uint32_t)recorder.len);
+    } else {
+        log_error("replay: disk write failed\n");
     }
+#endif
+    log_info("replay: tick %u, checksum %08x\n", tetris_tick, tetris_checksum());
 }
-//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-void rotate_shape() {
-    int new_rotation = (game_state.current_rotation + 1) % 4;
-    int can_rotate = 1;
-    
-    // Check if rotation is possible
-    for (int i = 0; i < 4; i++) {
-        int new_x = game_state.current_x + shapes[game_state.current_shape_type][new_rotation][i][0];
-        int new_y = game_state.current_y + shapes[game_state.current_shape_type][new_rotation][i][1];
-        
-        // Check for board boundaries and collisions
-        if (new_x < 0 || new_x >= BOARD_WIDTH || 
-            new_y < 0 || new_y >= BOARD_HEIGHT ||
-            (new_y >= 0 && game_state.board[new_x][new_y])) {
-            can_rotate = 0;
-            break;
-        }
+
+#ifdef REPLAY_PLAYBACK
+// Load the replay and return its seed
+uint32_t replay_load() {
+    uint32_t nb_sectors = REPLAY_BUFFER_SIZE / BLKDEV_SECTOR_SIZE;
+    if (BLKDEV->DISK_SIZE / BLKDEV_SECTOR_SIZE < nb_sectors) {
+        nb_sectors = BLKDEV->DISK_SIZE / BLKDEV_SECTOR_SIZE;
     }
-    
-    // Apply rotation if possible
-    if (can_rotate) {
-        game_state.current_rotation = new_rotation;
-        memcpy(game_state.current_shape, 
-               shapes[game_state.current_shape_type][new_rotation], 
-               sizeof(game_state.current_shape));
+    if (!blkdev_transfer(BLKDEV_CR_RD, replay_buffer, nb_sectors) ||
+        !replay_reader_init(&player, replay_buffer, nb_sectors * BLKDEV_SECTOR_SIZE)) {
+        // Synchronous: no log task will ever run to send a buffered message
+        xprintf("replay: no replay on disk\n");
+        minirisc_halt();
+    }
+    playing = 1;
+    return player.seed;
+}
+
+// Called by the sim task before each step, returns 0 once the replay is over
+int replay_feed() {
+    if (!playing) {
+        return 0;
+    }
+    int status = replay_apply(&player, tetris_tick);
+    if (status > 0) {
+        return 1;
+    }
+    playing = 0;
+    if (status < 0) {
+        log_error("replay: corrupt or truncated at tick %u\n", tetris_tick);
+    } else {
+        log_info("replay: %u ticks, checksum %08x, recorded %08x: %s\n", tetris_tick,
+                 tetris_checksum(), player.next.checksum,
+                 tetris_checksum() == player.next.checksum ? "match" : "MISMATCH");
     }
+    log_info("replay: sim %u ns/step, render %u us/frame\n",
+             (uint32_t)(sim_ns / (tetris_tick ? tetris_tick : 1)),
+             (uint32_t)(render_ns / 1000 / (render_frames ? render_frames : 1)));
+    return 0;
 }
+#endif
 
+#if !defined(REPLAY_PLAYBACK) && !defined(TETRIS_AUTOPLAY)
+// Game action bound to a key, -1 for none
+static int key_action(uint16_t key_code)
+{
+    switch (key_code) {
+        case 32: return ACTION_ROTATE;     // Space - Rotate clockwise
+        case 122: return ACTION_ROTATE_CCW; // z - Rotate counter-clockwise
+        case 80: return ACTION_LEFT;       // Left arrow
+        case 79: return ACTION_RIGHT;      // Right arrow
+        case 81: return ACTION_SOFT_DROP;  // Down arrow - Soft drop
+        case 82: return ACTION_HARD_DROP;  // Up arrow - Hard drop
+        default: return -1;
+    }
+}
+#endif
 
-int can_move(int dx, int dy) {
-    for (int i = 0; i < 4; i++) {
-        int new_x = game_state.current_x + game_state.current_shape[i][0] + dx;
-        int new_y = game_state.current_y + game_state.current_shape[i][1] + dy;
-        
-        // Check boundaries
-        if (new_x < 0 || new_x >= BOARD_WIDTH || 
-            new_y >= BOARD_HEIGHT) {
-            return 0;
+// Drain the input ring into the key state of the game. Auto-repeat is timed
+// by the simulation step (DAS/ARR), not by the host key repeat.
+void process_input()
+{
+    input_event_t event;
+    while (input_pop(&event)) {
+        if (event.pressed && event.key_code == 27) { // Q - Quit
+#ifndef REPLAY_PLAYBACK
+            replay_save();
+#endif
+            // No return: the other tasks get the game mutex back while the
+            // log drains
+            xSemaphoreGive(game_mutex);
+            log_flush();
+            minirisc_halt();
         }
-        
-        // Check board collisions, ignore checks above board
-        if (new_y >= 0 && game_state.board[new_x][new_y]) {
-            return 0;
+        // Keys only quit when the replay or the AI drives the game
+#if !defined(REPLAY_PLAYBACK) && !defined(TETRIS_AUTOPLAY)
+        int action = key_action(event.key_code);
+        if (action < 0) {
+            continue;
         }
+        if (event.pressed) {
+            tetris_press(action);
+        } else {
+            tetris_release(action);
+        }
+        replay_write_event(&recorder, tetris_tick, action, event.pressed);
+#endif
+    }
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Whether the falling piece, moved to row py, covers cell (x, y)
+int shape_covers(int x, int y, int py) {
+    int r = y - py;
+    if (r < 0 || r > 3) {
+        return 0;
+    }
+    const shape_mask_t *m = &shape_masks[game_state.current_shape_type][game_state.current_rotation];
+    return (shape_row(m, r, game_state.current_x) >> x) & 1;
+}
+
+// Repaint one board cell: the falling piece on top, then the locked blocks,
+// then the ghost of the piece, else the background layer (black with its
+// top/left grid lines).
+void draw_cell(int x, int y) {
+    int sx = x * SQUARE_SIZE;
+    int sy = y * SQUARE_SIZE;
+    if (shape_covers(x, y, game_state.current_y)) {
+        raster_blit_tile(frame_buffer, sx, sy, cell_tiles[game_state.current_shape_type + 1]);
+    } else if (game_state.board_colors[y][x] || !shape_covers(x, y, game_state.ghost_y)) {
+        raster_blit_tile(frame_buffer, sx, sy, cell_tiles[game_state.board_colors[y][x]]);
+    } else {
+        raster_blit_tile(frame_buffer, sx, sy, ghost_tiles[game_state.current_shape_type]);
     }
-    return 1;
 }
 
-void move_shape(int dx, int dy) {
-    if (can_move(dx, dy)) {
-        game_state.current_x += dx;
-        game_state.current_y += dy;
-    } else if (dy > 0) {
-        // Piece has landed, add to board
-        for (int i = 0; i < 4; i++) {
-            int x = game_state.current_x + game_state.current_shape[i][0];
-            int y = game_state.current_y + game_state.current_shape[i][1];
-            
-            if (x >= 0 && x < BOARD_WIDTH && y >= 0 && y < BOARD_HEIGHT) {
-                game_state.board[x][y] = game_state.current_shape_type + 1;
+// Bring the back buffer up to date
+void draw_dirty_cells() {
+    int back = 1 - front_buffer;
+    frame_buffer = frame_buffers[back];
+
+    for (int y = 0; y < BOARD_HEIGHT; y++) {
+        dirty_cells[0][y] |= board_damage[y];
+        dirty_cells[1][y] |= board_damage[y];
+        board_damage[y] = 0;
+        uint16_t dirty = dirty_cells[back][y];
+        dirty_cells[back][y] = 0;
+        for (int x = 0; dirty; x++, dirty >>= 1) {
+            if (dirty & 1) {
+                draw_cell(x, y);
             }
         }
-        
-        // Spawn new shape
-        spawn_shape();
     }
 }
 
-void spawn_shape() {
-    // Randomly select a shape
-    game_state.current_shape_type = rand() % NUM_SHAPES;
-    game_state.current_rotation = 0;
-    
-    // Start at top center
-    game_state.current_x = BOARD_WIDTH / 2 - 2;
-    game_state.current_y = 0;
-    
-    // Check for game over
-    for (int i = 0; i < 4; i++) {
-        int x = game_state.current_x + shapes[game_state.current_shape_type][0][i][0];
-        int y = game_state.current_y + shapes[game_state.current_shape_type][0][i][1];
-        
-        if (game_state.board[x][y]) {
-            // Game over reset
-            memset(&game_state, 0, sizeof(game_state));
-        }
+void report_render_stats() {
+    total_pixels_written += raster_pixels_written;
+    frames_drawn++;
+    if (frames_drawn % RENDER_STATS_PERIOD == 0) {
+        log_info("Pixels: %u last frame, %u avg/frame, %u missed vblanks\n", raster_pixels_written,
+                 (uint32_t)(total_pixels_written / frames_drawn), missed_vblanks);
     }
-    
-    // Copy initial shape configuration
-    memcpy(game_state.current_shape, 
-           shapes[game_state.current_shape_type][0], 
-           sizeof(game_state.current_shape));
+    raster_pixels_written = 0;
 }
-//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-void check_line_clear() {
-    int lines_cleared = 0;
-    for (int y = BOARD_HEIGHT - 1; y >= 0; y--) {
-        int line_full = 1;
-        for (int x = 0; x < BOARD_WIDTH; x++) {
-            if (!game_state.board[x][y]) {
-                line_full = 0;
-                break;
-            }
-        }
-        
-        if (line_full) {
-            // Remove the line and shift down
-            for (int ny = y; ny > 0; ny--) {
-                for (int x = 0; x < BOARD_WIDTH; x++) {
-                    game_state.board[x][ny] = game_state.board[x][ny-1];
-                }
-            }
-            
-            // Clear top line
-            for (int x = 0; x < BOARD_WIDTH; x++) {
-                game_state.board[x][0] = 0;
-            }
-            
-            lines_cleared++;
-            y++; // Recheck this line as it's now a new line
-        }
+
+void report_input_stats() {
+    if (frames_drawn % RENDER_STATS_PERIOD == 0 && input_stats.isr_count) {
+        log_info("Keyboard ISR: %u calls, %u avg / %u max instructions, %u events, %u dropped, %u repeats ignored\n",
+                 input_stats.isr_count,
+                 (uint32_t)(input_stats.isr_instructions / input_stats.isr_count),
+                 input_stats.isr_max_instructions,
+                 input_stats.events, input_stats.overflows, input_stats.repeats);
     }
+}
+
+// Bring the HUD of the back buffer up to date, no-op unless a value changed
+void draw_hud() {
+    hud_values_t *drawn = &hud_drawn[1 - front_buffer];
     
-    // Update score
-    if (lines_cleared > 0) {
-        static int score_multiplier[] = {0, 40, 100, 300, 1200};
-        game_state.score += score_multiplier[lines_cleared] * (game_state.level + 1);
-        game_state.lines_cleared += lines_cleared;
-        game_state.level = game_state.lines_cleared / 10;
+    if (drawn->score != game_state.score) {
+        drawn->score = game_state.score;
+        draw_hud_value(HUD_SCORE_Y, drawn->score);
+    }
+    if (drawn->level != game_state.level) {
+        drawn->level = game_state.level;
+        draw_hud_value(HUD_LEVEL_Y, drawn->level);
+    }
+    if (drawn->lines != game_state.lines_cleared) {
+        drawn->lines = game_state.lines_cleared;
+        draw_hud_value(HUD_LINES_Y, drawn->lines);
+    }
+    if (drawn->next != tetris_preview(0)) {
+        drawn->next = tetris_preview(0);
+        draw_hud_next(drawn->next);
     }
 }
-
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-volatile int refresh_event = 0;
-
-void video_interrupt_handler()
+void input_task(void *arg)
 {
-    VIDEO->SR = 0;
-    refresh_event = 1;
+    (void)arg;
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        xSemaphoreTake(game_mutex, portMAX_DELAY);
+        process_input();
+        xSemaphoreGive(game_mutex);
+    }
 }
 
-void keyboard_interrupt_handler()
+// Fixed timestep: the elapsed RTC time is accumulated and consumed in whole
+// TETRIS_STEP_MS steps, so the game speed depends neither on the video refresh
+// rate nor on the tick jitter. After a stall (e.g. long frames holding the
+// game mutex) up to SIM_MAX_CATCHUP steps run back to back, anything beyond
+// is dropped rather than fast-forwarding the game.
+#define SIM_STEP_NS     ((uint64_t)TETRIS_STEP_MS * 1000000)
+#define SIM_MAX_CATCHUP 5
+
+static uint32_t sim_steps;
+static uint32_t sim_catchup_max;  // most steps run on a single wake up
+static uint32_t sim_dropped;      // steps skipped past SIM_MAX_CATCHUP
+
+#ifdef TETRIS_AUTOPLAY
+// Built with -DTETRIS_AUTOPLAY, the AI places a piece every AI_MOVE_STEPS
+// steps and the keyboard only quits. The placement search must fit in
+// AI_INSTRUCTION_BUDGET retired instructions to stay well inside one step.
+// AI moves are not key events: such sessions replay with an autoplay build.
+#define AI_MOVE_STEPS         20
+#define AI_INSTRUCTION_BUDGET 40000
+
+static uint32_t ai_moves;
+static uint64_t ai_instructions;
+static uint32_t ai_max_instructions;
+static uint32_t ai_over_budget;
+
+static void ai_step() {
+    if (tetris_tick % AI_MOVE_STEPS) {
+        return;
+    }
+    uint64_t start = minirisc_nb_instruction_retired();
+    ai_play();
+    uint32_t duration = (uint32_t)(minirisc_nb_instruction_retired() - start);
+    ai_moves++;
+    ai_instructions += duration;
+    if (duration > ai_max_instructions) {
+        ai_max_instructions = duration;
+    }
+    if (duration > AI_INSTRUCTION_BUDGET) {
+        ai_over_budget++;
+    }
+}
+#endif
+
+void sim_task(void *arg)
 {
-    uint32_t kdata;
-    while (KEYBOARD->SR & KEYBOARD_SR_FIFO_NOT_EMPTY) {
-        kdata = KEYBOARD->DATA;
-        if (kdata & KEYBOARD_DATA_PRESSED) {
-			xprintf("%d\n",KEYBOARD_KEY_CODE(kdata));
-            switch (KEYBOARD_KEY_CODE(kdata)) {
-                case 27: // Q - Quit
-                    minirisc_halt();
-                    break;
-                case 32: // Space - Rotate
-                    rotate_shape();
-                    break;
-                case 80: // Left arrow
-                    move_shape(-1, 0);
-                    break;
-                case 79: // Right arrow
-                    move_shape(1, 0);
-                    break;
-                case 81: // Down arrow - Soft drop
-                    move_shape(0, 1);
-                    break;
+    (void)arg;
+    TickType_t last_wake = xTaskGetTickCount();
+    uint64_t last_time = RTC->NSEC;
+    uint64_t accumulator = 0;
+    
+    while (1) {
+        vTaskDelayUntil(&last_wake, MS2TICKS(TETRIS_STEP_MS));
+        
+        uint64_t now = RTC->NSEC;
+        accumulator += now - last_time;
+        last_time = now;
+        
+        uint32_t steps = 0;
+        xSemaphoreTake(game_mutex, portMAX_DELAY);
+        while (accumulator >= SIM_STEP_NS && steps < SIM_MAX_CATCHUP) {
+#ifdef REPLAY_PLAYBACK
+            if (!replay_feed()) {
+                accumulator = 0; // replay over, the game stays frozen
+                break;
             }
+#endif
+            uint64_t start = RTC->NSEC;
+#ifdef TETRIS_AUTOPLAY
+            ai_step();
+#endif
+            tetris_step();
+            sim_ns += RTC->NSEC - start;
+            accumulator -= SIM_STEP_NS;
+            steps++;
+        }
+        xSemaphoreGive(game_mutex);
+        
+        if (accumulator >= SIM_STEP_NS) {
+            sim_dropped += accumulator / SIM_STEP_NS;
+            accumulator %= SIM_STEP_NS;
+        }
+        sim_steps += steps;
+        if (steps > sim_catchup_max) {
+            sim_catchup_max = steps;
         }
     }
 }
-//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-void draw_current_shape() {
-    uint32_t current_color = shape_colors[game_state.current_shape_type];
-    for (int i = 0; i < 4; i++) {
-        int sx = (game_state.current_x + game_state.current_shape[i][0]) * SQUARE_SIZE;
-        int sy = (game_state.current_y + game_state.current_shape[i][1]) * SQUARE_SIZE;
-        draw_square(sx, sy, SQUARE_SIZE, current_color);
+
+void render_task(void *arg)
+{
+    (void)arg;
+    while (1) {
+        // Woken at vblank. A notification left over from a missed vblank may
+        // arrive before the flip: never draw into a buffer that is about to be shown.
+        do {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        } while (flip_pending);
+        render_busy = 1;
+        
+        // Repaint only the cells changed since this buffer was last drawn
+        xSemaphoreTake(game_mutex, portMAX_DELAY);
+        uint64_t start = RTC->NSEC;
+        draw_dirty_cells();
+        draw_hud();
+        render_ns += RTC->NSEC - start;
+        render_frames++;
+        xSemaphoreGive(game_mutex);
+        
+        // Hand the back buffer to the video ISR for the next vblank
+        render_busy = 0;
+        flip_pending = 1;
+        
+        report_render_stats();
+        report_input_stats();
     }
 }
 
-void draw_static_board() {
-    for (int y = 0; y < BOARD_HEIGHT; y++) {
-        for (int x = 0; x < BOARD_WIDTH; x++) {
-            if (game_state.board[x][y]) {
-                draw_square(x * SQUARE_SIZE, y * SQUARE_SIZE, 
-                            SQUARE_SIZE, 
-                            shape_colors[game_state.board[x][y] - 1]);
-            }
+// Per-task CPU time, from the RTC based run-time counter (get_run_time_counter_value)
+void stats_task(void *arg)
+{
+    (void)arg;
+    TickType_t last_wake = xTaskGetTickCount();
+    uint32_t last_tx_bytes = 0;
+    uint32_t last_wakeups = 0;
+    
+    while (1) {
+        vTaskDelayUntil(&last_wake, MS2TICKS(STATS_PERIOD_MS));
+        
+        UBaseType_t nb_tasks = uxTaskGetNumberOfTasks();
+        TaskStatus_t *status = pvPortMalloc(nb_tasks * sizeof(TaskStatus_t));
+        if (status == NULL) {
+            continue;
+        }
+        configRUN_TIME_COUNTER_TYPE total_time;
+        nb_tasks = uxTaskGetSystemState(status, nb_tasks, &total_time);
+        if (total_time == 0) {
+            total_time = 1;
         }
+        log_info("Task          run time (us)   %%\n");
+        for (UBaseType_t i = 0; i < nb_tasks; i++) {
+            log_info("%-12s  %12llu  %3u\n", status[i].pcTaskName,
+                     status[i].ulRunTimeCounter / 1000,
+                     (uint32_t)(status[i].ulRunTimeCounter * 100 / total_time));
+        }
+        vPortFree(status);
+        
+        log_info("sim: %u steps, catch-up max %u, %u dropped, %u ns/step; render %u us/frame\n",
+                 sim_steps, sim_catchup_max, sim_dropped,
+                 (uint32_t)(sim_ns / (sim_steps ? sim_steps : 1)),
+                 (uint32_t)(render_ns / 1000 / (render_frames ? render_frames : 1)));
+        log_info("log: %u messages, %u bytes, %u flushes, %u dropped, %u filtered, %u truncated\n",
+                 log_stats.messages, log_stats.bytes, log_stats.flushes,
+                 log_stats.dropped, log_stats.filtered, log_stats.truncated);
+        uint32_t tx_bytes = uart_stats.tx_bytes;
+        log_info("uart: %u bytes/s, %u transfers for %u writes (%u coalesced), queue max %u, %u waits\n",
+                 (tx_bytes - last_tx_bytes) * 1000 / STATS_PERIOD_MS, uart_stats.tx_transfers,
+                 uart_stats.tx_writes, uart_stats.tx_coalesced, uart_stats.tx_queue_max,
+                 uart_stats.tx_waits);
+        last_tx_bytes = tx_bytes;
+        // Tick interrupts and ends of tickless sleeps both wake the CPU
+        uint32_t wakeups = port_tick_stats.ticks + port_tick_stats.sleeps;
+        log_info("tick: %u Hz, %u wakeups/s, %u sleeps (%u ticks suppressed), jitter avg %u us, max %u us\n",
+                 (uint32_t)configTICK_RATE_HZ, (wakeups - last_wakeups) * 1000 / STATS_PERIOD_MS,
+                 port_tick_stats.sleeps, port_tick_stats.ticks_suppressed,
+                 (uint32_t)(port_tick_stats.jitter_total_ns / 1000 /
+                            (port_tick_stats.jitter_samples ? port_tick_stats.jitter_samples : 1)),
+                 port_tick_stats.jitter_max_ns / 1000);
+        last_wakeups = wakeups;
+#ifdef TETRIS_AUTOPLAY
+        log_info("ai: %u moves, %u instructions/move, max %u, %u over budget (%u)\n",
+                 ai_moves, (uint32_t)(ai_instructions / (ai_moves ? ai_moves : 1)),
+                 ai_max_instructions, ai_over_budget, AI_INSTRUCTION_BUDGET);
+#endif
     }
 }
 
-void draw_score() {
-    // Simple text drawing (this would require a font implementation)
-    xprintf("Score: %d\n", game_state.score);
-    xprintf("Level: %d\n", game_state.level);
+#ifdef UART_RX_BENCHMARK
+#define UART_RX_BENCHMARK_BYTES (256 * 1024)
+
+void uart_rx_benchmark_task(void *arg)
+{
+    (void)arg;
+    uart_rx_benchmark(UART_RX_BENCHMARK_BYTES);
+    vTaskDelete(NULL);
 }
+#endif
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 int main()
 {
     init_video();
     
     // Initialize game state
-    memset(&game_state, 0, sizeof(game_state));
-    srand(0); // Simple seed for random shape generation
+#ifdef REPLAY_PLAYBACK
+    uint32_t seed = replay_load();
+#else
+    uint32_t seed = (uint32_t)RTC->NSEC; // a different piece stream on every boot
+#endif
+    tetris_init(seed);
+    replay_writer_init(&recorder, replay_buffer, REPLAY_BUFFER_SIZE, seed);
     
-    spawn_shape();
+    // Console output goes through the buffered log sink, over UART DMA
+    init_uart();
+    log_init(LOG_TASK_PRIORITY);
     
-    // Enable interrupts
-    KEYBOARD->CR |= KEYBOARD_CR_IE;
-    minirisc_enable_interrupt(VIDEO_INTERRUPT |KEYBOARD_INTERRUPT);
-    minirisc_enable_global_interrupts();
+    game_mutex = xSemaphoreCreateMutex();
+    xTaskCreate(input_task,  "input",  configMINIMAL_STACK_SIZE * 2, NULL, INPUT_TASK_PRIORITY,  &input_task_handle);
+    xTaskCreate(sim_task,    "sim",    configMINIMAL_STACK_SIZE * 2, NULL, SIM_TASK_PRIORITY,    &sim_task_handle);
+    xTaskCreate(render_task, "render", configMINIMAL_STACK_SIZE * 4, NULL, RENDER_TASK_PRIORITY, &render_task_handle);
+    xTaskCreate(stats_task,  "stats",  configMINIMAL_STACK_SIZE * 4, NULL, STATS_TASK_PRIORITY,  &stats_task_handle);
+#ifdef UART_RX_BENCHMARK
+    xTaskCreate(uart_rx_benchmark_task, "uart_rx", configMINIMAL_STACK_SIZE * 2, NULL, INPUT_TASK_PRIORITY, NULL);
+#endif
     
-    // Game loop
-    int drop_timer = 0;
-    int drop_speed = 30; // Adjustable drop speed
+    // Enable interrupts (globally enabled when the scheduler starts the first task)
+    KEYBOARD->CR |= KEYBOARD_CR_IE;
+    minirisc_enable_interrupt(VIDEO_INTERRUPT | KEYBOARD_INTERRUPT);
     
-    while (1) {
-        minirisc_wait_for_interrupt();
-        
-        if (refresh_event) {
-            refresh_event = 0;
-            memset(frame_buffer, 0, sizeof(frame_buffer));
-            
-            // Draw board grid
-            draw_board_grid();
-            
-            // Game logic: periodic shape drop
-            drop_timer++;
-            if (drop_timer >= drop_speed) { // Adjust for game speed
-                drop_timer = 0;
-                move_shape(0, 1);
-            }
-            
-            // Check for completed lines
-            check_line_clear();
-            
-            // Draw static board pieces
-            draw_static_board();
-            
-            // Draw current falling shape
-            draw_current_shape();
-            
-            // Draw score (would need font implementation)
-            draw_score();
-        }
-    }
+    vTaskStartScheduler();
     
     return 0;
 }
-
-
-
-
-
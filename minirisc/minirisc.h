@@ -132,4 +132,18 @@ void __attribute__((section(".minirisc_irq_handlers"),interrupt("machine"))) swi
 	})
 
 
+/* Mask interrupts and return the previous state. Unlike portENTER_CRITICAL(),
+ * which unmasks them on exit, usable from ISRs and nested sections alike. */
+static inline uint32_t minirisc_save_and_disable_interrupts()
+{
+	return csr_read_and_clearbits(mstatus, 0x00000009);
+}
+
+
+static inline void minirisc_restore_interrupts(uint32_t state)
+{
+	csr_setbits(mstatus, state & 0x00000009);
+}
+
+
 #endif /* MINIRISC_H */
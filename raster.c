@@ -0,0 +1,188 @@
+#include "raster.h"
+#include "minirisc.h"
+#include "log.h"
+
+uint32_t raster_row_offset[SCREEN_HEIGHT];
+uint32_t raster_pixels_written;
+
+void raster_init() {
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        raster_row_offset[y] = y * SCREEN_WIDTH;
+    }
+}
+
+void raster_fill_span(uint32_t *dst, int n, uint32_t color) {
+    uint32_t *end = dst + n;
+
+    raster_pixels_written += n;
+    while (end - dst >= 8) {
+        dst[0] = color;
+        dst[1] = color;
+        dst[2] = color;
+        dst[3] = color;
+        dst[4] = color;
+        dst[5] = color;
+        dst[6] = color;
+        dst[7] = color;
+        dst += 8;
+    }
+    while (dst < end) {
+        *dst++ = color;
+    }
+}
+
+void raster_copy_span(uint32_t *dst, const uint32_t *src, int n) {
+    uint32_t *end = dst + n;
+
+    raster_pixels_written += n;
+    while (end - dst >= 8) {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+        dst[3] = src[3];
+        dst[4] = src[4];
+        dst[5] = src[5];
+        dst[6] = src[6];
+        dst[7] = src[7];
+        dst += 8;
+        src += 8;
+    }
+    while (dst < end) {
+        *dst++ = *src++;
+    }
+}
+
+void raster_copy_rect(uint32_t *dst, int dst_pitch, const uint32_t *src, int src_pitch, int w, int h) {
+    while (h-- > 0) {
+        raster_copy_span(dst, src, w);
+        dst += dst_pitch;
+        src += src_pitch;
+    }
+}
+
+#if RASTER_TILE_SIZE % 4 != 0
+#error "raster_blit_tile copies 4 words per step, RASTER_TILE_SIZE must be a multiple of 4"
+#endif
+
+void raster_blit_tile(uint32_t *fb, int x, int y, const uint32_t *tile) {
+    if (x < 0 || y < 0 || x + RASTER_TILE_SIZE > SCREEN_WIDTH || y + RASTER_TILE_SIZE > SCREEN_HEIGHT) {
+        int x0 = x < 0 ? -x : 0;
+        int y0 = y < 0 ? -y : 0;
+        int x1 = x + RASTER_TILE_SIZE > SCREEN_WIDTH ? SCREEN_WIDTH - x : RASTER_TILE_SIZE;
+        int y1 = y + RASTER_TILE_SIZE > SCREEN_HEIGHT ? SCREEN_HEIGHT - y : RASTER_TILE_SIZE;
+        if (x0 < x1 && y0 < y1) {
+            raster_copy_rect(&RASTER_PIXEL(fb, x + x0, y + y0), SCREEN_WIDTH,
+                             &tile[y0 * RASTER_TILE_SIZE + x0], RASTER_TILE_SIZE, x1 - x0, y1 - y0);
+        }
+        return;
+    }
+
+    uint32_t *dst = &RASTER_PIXEL(fb, x, y);
+    for (int j = 0; j < RASTER_TILE_SIZE; j++) {
+        for (int i = 0; i < RASTER_TILE_SIZE; i += 4) {
+            dst[i + 0] = tile[i + 0];
+            dst[i + 1] = tile[i + 1];
+            dst[i + 2] = tile[i + 2];
+            dst[i + 3] = tile[i + 3];
+        }
+        dst  += SCREEN_WIDTH;
+        tile += RASTER_TILE_SIZE;
+    }
+    raster_pixels_written += RASTER_TILE_PIXELS;
+}
+
+void raster_hline(uint32_t *fb, int x, int y, int len, uint32_t color) {
+    raster_fill_span(&RASTER_PIXEL(fb, x, y), len, color);
+}
+
+void raster_vline(uint32_t *fb, int x, int y, int len, uint32_t color) {
+    uint32_t *p = &RASTER_PIXEL(fb, x, y);
+
+    raster_pixels_written += len;
+    while (len-- > 0) {
+        *p = color;
+        p += SCREEN_WIDTH;
+    }
+}
+
+void raster_vlines(uint32_t *fb, int x, int spacing, int count, int y, int len, uint32_t color) {
+    raster_pixels_written += len * count;
+    for (int j = y; j < y + len; j++) {
+        uint32_t *p = &RASTER_PIXEL(fb, x, j);
+        for (int i = 0; i < count; i++) {
+            *p = color;
+            p += spacing;
+        }
+    }
+}
+
+void raster_fill_rect(uint32_t *fb, int x, int y, int w, int h, uint32_t color) {
+    int x_end = x + w;
+    int y_end = y + h;
+
+    if (x < 0) {
+        x = 0;
+    }
+    if (y < 0) {
+        y = 0;
+    }
+    if (x_end > SCREEN_WIDTH) {
+        x_end = SCREEN_WIDTH;
+    }
+    if (y_end > SCREEN_HEIGHT) {
+        y_end = SCREEN_HEIGHT;
+    }
+    if (x >= x_end || y >= y_end) {
+        return;
+    }
+
+    for (int j = y; j < y_end; j++) {
+        raster_fill_span(&RASTER_PIXEL(fb, x, j), x_end - x, color);
+    }
+}
+
+static void raster_report(const char *name, uint64_t start, uint32_t pixels) {
+    uint32_t insn = (uint32_t)(minirisc_nb_instruction_retired() - start);
+    log_info("%-24s %8u pixels  %10u insn  %u.%02u insn/pixel\n", name, pixels, insn,
+             insn / pixels, (insn % pixels) * 100 / pixels);
+}
+
+void raster_benchmark(uint32_t *fb) {
+    uint64_t start;
+
+    start = minirisc_nb_instruction_retired();
+    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
+        fb[i] = 0;
+    }
+    raster_report("naive pixel loop", start, SCREEN_WIDTH * SCREEN_HEIGHT);
+
+    start = minirisc_nb_instruction_retired();
+    raster_fill_span(fb, SCREEN_WIDTH * SCREEN_HEIGHT, 0);
+    raster_report("span fill (full screen)", start, SCREEN_WIDTH * SCREEN_HEIGHT);
+
+    start = minirisc_nb_instruction_retired();
+    for (int y = 0; y + 20 <= SCREEN_HEIGHT; y += 20) {
+        for (int x = 0; x + 20 <= SCREEN_WIDTH; x += 20) {
+            raster_fill_rect(fb, x, y, 20, 20, 0);
+        }
+    }
+    raster_report("fill_rect 20x20", start, SCREEN_WIDTH * SCREEN_HEIGHT);
+
+    start = minirisc_nb_instruction_retired();
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        raster_hline(fb, 0, y, SCREEN_WIDTH, 0);
+    }
+    raster_report("hline", start, SCREEN_WIDTH * SCREEN_HEIGHT);
+
+    start = minirisc_nb_instruction_retired();
+    for (int x = 0; x < SCREEN_WIDTH; x++) {
+        raster_vline(fb, x, 0, SCREEN_HEIGHT, 0);
+    }
+    raster_report("vline", start, SCREEN_WIDTH * SCREEN_HEIGHT);
+
+    start = minirisc_nb_instruction_retired();
+    raster_vlines(fb, 0, 1, SCREEN_WIDTH, 0, SCREEN_HEIGHT, 0);
+    raster_report("vlines (raster order)", start, SCREEN_WIDTH * SCREEN_HEIGHT);
+
+    raster_pixels_written = 0;
+}
@@ -0,0 +1,53 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stdint.h>
+
+/* Small raster library for the 32 bpp frame buffers: word-wide span fills,
+ * horizontal/vertical line primitives and clipped rectangles. All primitives
+ * address rows through a precomputed row-offset table and count the pixels
+ * they write in raster_pixels_written.
+ */
+
+#define SCREEN_WIDTH  640
+#define SCREEN_HEIGHT 480
+
+// Size of the square tiles handled by raster_blit_tile (one board cell)
+#define RASTER_TILE_SIZE 20
+#define RASTER_TILE_PIXELS (RASTER_TILE_SIZE * RASTER_TILE_SIZE)
+
+extern uint32_t raster_row_offset[SCREEN_HEIGHT]; // y * SCREEN_WIDTH
+extern uint32_t raster_pixels_written;
+
+#define RASTER_PIXEL(fb, x, y) ((fb)[raster_row_offset[y] + (x)])
+
+void raster_init();
+
+// Fill n consecutive pixels, 8 words per iteration
+void raster_fill_span(uint32_t *dst, int n, uint32_t color);
+
+// Unclipped primitives: the caller guarantees the pixels are on screen
+void raster_hline(uint32_t *fb, int x, int y, int len, uint32_t color);
+void raster_vline(uint32_t *fb, int x, int y, int len, uint32_t color);
+
+// count vertical lines spaced by spacing pixels, drawn in raster order (row by
+// row) instead of column by column
+void raster_vlines(uint32_t *fb, int x, int spacing, int count, int y, int len, uint32_t color);
+
+// Copy n consecutive pixels, 8 words per iteration
+void raster_copy_span(uint32_t *dst, const uint32_t *src, int n);
+
+// Unclipped copy of a w x h block, pitches are in pixels
+void raster_copy_rect(uint32_t *dst, int dst_pitch, const uint32_t *src, int src_pitch, int w, int h);
+
+// Blit a RASTER_TILE_SIZE x RASTER_TILE_SIZE tile at (x, y). Tiles fully on
+// screen take a fixed-size, unrolled, clip-free path; others are clipped.
+void raster_blit_tile(uint32_t *fb, int x, int y, const uint32_t *tile);
+
+// Clipped rectangle fill
+void raster_fill_rect(uint32_t *fb, int x, int y, int w, int h, uint32_t color);
+
+// Micro-benchmark of the primitives, logs the instructions retired per pixel
+void raster_benchmark(uint32_t *fb);
+
+#endif /* RASTER_H */
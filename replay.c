@@ -0,0 +1,167 @@
+#include <string.h>
+#include "replay.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static int put_byte(replay_writer_t *w, uint8_t b) {
+    if (w->len == w->size) {
+        w->overflow = 1;
+        return 0;
+    }
+    w->buf[w->len++] = b;
+    return 1;
+}
+
+static void put_u32(replay_writer_t *w, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        put_byte(w, v >> (8 * i));
+    }
+}
+
+static void put_varint(replay_writer_t *w, uint32_t v) {
+    while (v >= 0x80) {
+        put_byte(w, (v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    put_byte(w, v);
+}
+
+// A record is written whole or not at all
+static int put_record(replay_writer_t *w, uint32_t tick, uint8_t code) {
+    size_t len = w->len;
+    if (w->overflow) {
+        return 0;
+    }
+    put_varint(w, tick - w->last_tick);
+    put_byte(w, code);
+    if (w->overflow) {
+        w->len = len;
+        return 0;
+    }
+    w->last_tick = tick;
+    return 1;
+}
+
+void replay_writer_init(replay_writer_t *w, uint8_t *buf, size_t size, uint32_t seed) {
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->last_tick = 0;
+    w->overflow = 0;
+    for (int i = 0; i < 4; i++) {
+        put_byte(w, REPLAY_MAGIC[i]);
+    }
+    put_u32(w, seed);
+}
+
+int replay_write_event(replay_writer_t *w, uint32_t tick, tetris_action_t action, int pressed) {
+    // Keep room for the end record (up to 5 + 1 + 4 bytes)
+    if (w->len + 10 + 6 > w->size) {
+        w->overflow = 1;
+        return 0;
+    }
+    return put_record(w, tick, action << 1 | (pressed != 0));
+}
+
+// The end record always has room, see replay_write_event. Returns 0 if the
+// replay was truncated.
+int replay_write_end(replay_writer_t *w, uint32_t tick, uint32_t checksum) {
+    int truncated = w->overflow;
+    w->overflow = 0;
+    put_record(w, tick, REPLAY_END);
+    put_u32(w, checksum);
+    w->overflow |= truncated;
+    return !w->overflow;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static int get_byte(replay_reader_t *r, uint8_t *b) {
+    if (r->pos == r->len) {
+        return 0;
+    }
+    *b = r->buf[r->pos++];
+    return 1;
+}
+
+static int get_u32(replay_reader_t *r, uint32_t *v) {
+    uint8_t b;
+    *v = 0;
+    for (int i = 0; i < 4; i++) {
+        if (!get_byte(r, &b)) {
+            return 0;
+        }
+        *v |= (uint32_t)b << (8 * i);
+    }
+    return 1;
+}
+
+static int get_varint(replay_reader_t *r, uint32_t *v) {
+    uint8_t b;
+    *v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (!get_byte(r, &b)) {
+            return 0;
+        }
+        *v |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Decode the next record into r->next
+static void read_record(replay_reader_t *r) {
+    uint32_t delta;
+    uint8_t code;
+    if (!get_varint(r, &delta) || !get_byte(r, &code)) {
+        r->status = -1;
+        return;
+    }
+    r->next.tick += delta;
+    r->next.end = code == REPLAY_END;
+    if (r->next.end) {
+        if (!get_u32(r, &r->next.checksum)) {
+            r->status = -1;
+        }
+        return;
+    }
+    r->next.action = code >> 1;
+    r->next.pressed = code & 1;
+    if (r->next.action >= NUM_ACTIONS) {
+        r->status = -1;
+    }
+}
+
+int replay_reader_init(replay_reader_t *r, const uint8_t *buf, size_t len) {
+    memset(r, 0, sizeof(*r));
+    r->buf = buf;
+    r->len = len;
+    if (len < REPLAY_HEADER_SIZE || memcmp(buf, REPLAY_MAGIC, 4)) {
+        return 0;
+    }
+    r->pos = 4;
+    get_u32(r, &r->seed);
+    r->status = 1;
+    read_record(r);
+    return 1;
+}
+
+int replay_apply(replay_reader_t *r, uint32_t tick) {
+    while (r->status == 1 && r->next.tick == tick) {
+        if (r->next.end) {
+            r->status = 0;
+            break;
+        }
+        if (r->next.pressed) {
+            tetris_press(r->next.action);
+        } else {
+            tetris_release(r->next.action);
+        }
+        read_record(r);
+    }
+    if (r->status == 1 && r->next.tick < tick) {
+        r->status = -1; // the player fell behind the recording
+    }
+    return r->status;
+}
+
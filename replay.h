@@ -0,0 +1,63 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "tetris.h"
+
+/* Replay format: a session is its seed plus the key presses and releases fed
+ * to the core, each tagged with the simulation tick (tetris_tick) before which
+ * it was applied. Since the core is deterministic, replaying the events at the
+ * same ticks rebuilds the exact same game_state, checked against the checksum
+ * stored in the end record.
+ *
+ *   header : "TRP1", seed (u32, little endian)
+ *   event  : tick delta (LEB128 varint), code = action << 1 | pressed
+ *   end    : tick delta (varint), REPLAY_END, tetris_checksum() (u32 LE)
+ *
+ * Tick deltas are relative to the previous record, so a typical event takes
+ * two bytes.
+ */
+
+#define REPLAY_MAGIC       "TRP1"
+#define REPLAY_HEADER_SIZE 8
+#define REPLAY_END         0xff
+
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    uint32_t last_tick;
+    int overflow; // an event did not fit, the replay is truncated
+} replay_writer_t;
+
+typedef struct {
+    uint32_t tick;
+    uint8_t end;      // end record: checksum is valid, action/pressed are not
+    uint8_t action;
+    uint8_t pressed;
+    uint32_t checksum;
+} replay_event_t;
+
+typedef struct {
+    const uint8_t *buf;
+    size_t len;
+    size_t pos;
+    uint32_t seed;
+    int status;           // 1 while next is valid, 0 after the end record, -1 on error
+    replay_event_t next;  // next record, not applied yet
+} replay_reader_t;
+
+void replay_writer_init(replay_writer_t *w, uint8_t *buf, size_t size, uint32_t seed);
+int  replay_write_event(replay_writer_t *w, uint32_t tick, tetris_action_t action, int pressed);
+int  replay_write_end(replay_writer_t *w, uint32_t tick, uint32_t checksum);
+
+// Returns 0 if the buffer does not hold a replay
+int  replay_reader_init(replay_reader_t *r, const uint8_t *buf, size_t len);
+
+// Feed the core the events recorded for this tick, to call before each
+// tetris_step(). Returns 1 while events remain, 0 when the end record is
+// reached at this tick, -1 on a truncated or corrupt replay.
+int  replay_apply(replay_reader_t *r, uint32_t tick);
+
+#endif /* REPLAY_H */
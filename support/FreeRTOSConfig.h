@@ -52,7 +52,14 @@
 #define configUSE_IDLE_HOOK                      1
 #define configUSE_TICK_HOOK                      0
 //#define configCPU_CLOCK_HZ                       ( SystemCoreClock )
-#define configTICK_RATE_HZ                       ((TickType_t)100)
+/* The tick timer counts at 1 kHz: the rate must divide 1000. Tickless idle
+   keeps the idle cost of a fast tick low. */
+#ifndef configTICK_RATE_HZ
+#define configTICK_RATE_HZ                       ((TickType_t)1000)
+#endif
+#ifndef configUSE_TICKLESS_IDLE
+#define configUSE_TICKLESS_IDLE                  1
+#endif
 #define configMAX_PRIORITIES                     ( 32 )
 #define configMINIMAL_STACK_SIZE                 ((uint16_t)128)
 //#define configTOTAL_HEAP_SIZE                    ((size_t)(30*1024*1024))
@@ -82,8 +82,20 @@ void vApplicationMallocFailedHook()
 
 
 #if ( configUSE_IDLE_HOOK != 0 )
+/* With tickless idle the idle task sleeps in portSUPPRESS_TICKS_AND_SLEEP(),
+   right after this hook: waiting here too would wake up on every tick again.
+   The kernel does not sleep when less than configEXPECTED_IDLE_TIME_BEFORE_SLEEP
+   ticks are idle, nor the port when the sleep is aborted: if the last pass did
+   not sleep, wait here instead of spinning. */
 void vApplicationIdleHook()
 {
+#if ( configUSE_TICKLESS_IDLE == 1 )
+	static uint32_t sleeps;
+	if (port_tick_stats.sleeps != sleeps) {
+		sleeps = port_tick_stats.sleeps;
+		return;
+	}
+#endif
 	minirisc_wait_for_interrupt();
 }
 #endif
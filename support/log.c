@@ -0,0 +1,162 @@
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "xprintf.h"
+#include "minirisc.h"
+#include "uart.h"
+#include "log.h"
+
+
+#define LOG_MASK (LOG_BUFFER_SIZE - 1)
+
+
+volatile log_level_t log_level = LOG_INFO;
+volatile log_stats_t log_stats;
+
+/* Messages are copied to the ring by log_printf() with interrupts masked. The
+ * flush task hands the bytes from log_sent to log_head to the UART without
+ * copying them, log_tail follows as the transfers complete: the DMA reads them
+ * in place. */
+static char log_buffer[LOG_BUFFER_SIZE];
+static volatile uint32_t log_head;
+static volatile uint32_t log_sent;
+static volatile uint32_t log_tail;
+
+/* Message being formatted on the stack of its caller. An ISR logging in the
+ * middle of it saves and restores the pointer, the scheduler is suspended
+ * while a task formats, so that formats always nest. */
+typedef struct {
+	char     buf[LOG_LINE_SIZE];
+	uint32_t len;
+	int      truncated;
+} log_line_t;
+
+static log_line_t *log_line;
+
+static TaskHandle_t log_task;
+
+
+static void log_putc(int c)
+{
+	if (log_line->len == LOG_LINE_SIZE) {
+		log_line->truncated = 1;
+		return;
+	}
+	log_line->buf[log_line->len++] = c;
+}
+
+
+void log_printf(log_level_t level, const char *fmt, ...)
+{
+	va_list arp;
+	log_line_t line;
+
+	if (level > log_level) {
+		log_stats.filtered++;
+		return;
+	}
+
+	/* With interrupts masked (ISR or critical section), no task can switch in */
+	int task = csr_read(mstatus) & 8;
+	if (task)
+		vTaskSuspendAll();
+	log_line_t *outer = log_line;
+	log_line = &line;
+	line.len = 0;
+	line.truncated = 0;
+	va_start(arp, fmt);
+	xvfprintf(log_putc, fmt, arp);
+	va_end(arp);
+	log_line = outer;
+	if (task)
+		xTaskResumeAll();
+
+	uint32_t state = minirisc_save_and_disable_interrupts();
+	if (log_head + line.len - log_tail > LOG_BUFFER_SIZE) {
+		log_stats.dropped++;
+	} else {
+		uint32_t start = log_head & LOG_MASK;
+		uint32_t first = line.len < LOG_BUFFER_SIZE - start ? line.len : LOG_BUFFER_SIZE - start;
+		memcpy(&log_buffer[start], line.buf, first);
+		memcpy(log_buffer, line.buf + first, line.len - first);
+		log_head += line.len;
+		log_stats.messages++;
+		log_stats.bytes += line.len;
+		log_stats.truncated += line.truncated;
+	}
+	minirisc_restore_interrupts(state);
+}
+
+
+/* Called from the UART TX interrupt once a span has been sent */
+static void log_tx_done(void *arg, size_t len)
+{
+	(void)arg;
+	log_tail += len;
+}
+
+
+/* Queue the bytes from log_sent up to head, one transfer per contiguous part
+ * of the ring. Interrupts are masked as both the flush task and log_flush()
+ * advance log_sent. Returns 0 when the UART queue is full before head. */
+static int log_queue(uint32_t head)
+{
+	uint32_t state = minirisc_save_and_disable_interrupts();
+	while ((int32_t)(head - log_sent) > 0) {
+		uint32_t start = log_sent & LOG_MASK;
+		uint32_t len = head - log_sent;
+		if (len > LOG_BUFFER_SIZE - start)
+			len = LOG_BUFFER_SIZE - start;
+		if (!uart_write_zero_copy(&log_buffer[start], len, log_tx_done, NULL))
+			break;
+		log_sent += len;
+		log_stats.flushes++;
+	}
+	int queued = (int32_t)(head - log_sent) <= 0;
+	minirisc_restore_interrupts(state);
+	return queued;
+}
+
+
+/* The task never waits for the UART: what cannot be queued now goes next
+ * time. */
+static void log_flush_task(void *arg)
+{
+	(void)arg;
+	TickType_t last_wake = xTaskGetTickCount();
+
+	while (1) {
+		vTaskDelayUntil(&last_wake, MS2TICKS(LOG_FLUSH_PERIOD_MS));
+		log_queue(log_head);
+	}
+}
+
+
+void log_init(uint32_t priority)
+{
+	xTaskCreate(log_flush_task, "log", configMINIMAL_STACK_SIZE * 2, NULL, priority, &log_task);
+}
+
+
+void log_suspend()
+{
+	vTaskSuspend(log_task);
+}
+
+
+void log_resume()
+{
+	vTaskResume(log_task);
+}
+
+
+void log_flush()
+{
+	uint32_t head = log_head;
+	while (!log_queue(head))
+		vTaskDelay(1);
+	uart_flush();
+}
+
@@ -0,0 +1,55 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+
+/* Buffered logging sink. Messages are formatted by xprintf and copied into a
+ * ring buffer, and a low priority task queues the ring to the UART TX DMA in
+ * batches, without copying (uart_write_zero_copy). log_printf() never blocks:
+ * it may be called from tasks and ISRs alike, a message that does not fit in
+ * the ring is dropped and counted.
+ */
+
+#define LOG_BUFFER_SIZE     4096 /* must be a power of two */
+#define LOG_FLUSH_PERIOD_MS 50
+#define LOG_LINE_SIZE       128  /* longer messages are truncated */
+
+typedef enum {
+	LOG_ERROR,
+	LOG_WARNING,
+	LOG_INFO,
+	LOG_DEBUG
+} log_level_t;
+
+typedef struct {
+	uint32_t messages;  /* messages written to the ring */
+	uint32_t bytes;     /* bytes written to the ring */
+	uint32_t dropped;   /* messages discarded because the ring was full */
+	uint32_t filtered;  /* messages above log_level */
+	uint32_t truncated; /* messages cut at LOG_LINE_SIZE */
+	uint32_t flushes;   /* spans queued to the UART */
+} log_stats_t;
+
+extern volatile log_level_t log_level; /* more verbose messages are discarded */
+extern volatile log_stats_t log_stats;
+
+/* Create the flush task. Needs init_uart(). */
+void log_init(uint32_t priority);
+
+/* Hold the flush task, e.g. while raw data goes out on the UART. Messages
+ * keep going to the ring and are sent after log_resume(). */
+void log_suspend();
+void log_resume();
+
+/* Queue the messages written so far without waiting for the flush task, even
+ * while it is held, then wait until the UART has sent them. Task context. */
+void log_flush();
+
+void log_printf(log_level_t level, const char *fmt, ...);
+
+#define log_error(...)   log_printf(LOG_ERROR,   __VA_ARGS__)
+#define log_warning(...) log_printf(LOG_WARNING, __VA_ARGS__)
+#define log_info(...)    log_printf(LOG_INFO,    __VA_ARGS__)
+#define log_debug(...)   log_printf(LOG_DEBUG,   __VA_ARGS__)
+
+#endif /* LOG_H */
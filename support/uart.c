@@ -1,62 +1,150 @@
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <errno.h>
 #include "FreeRTOS.h"
-#include "queue.h"
+#include "task.h"
 #include "semphr.h"
+#include "stream_buffer.h"
 #include "harvey_platform.h"
 #include "minirisc.h"
 #include "xprintf.h"
 #include "uart.h"
+#include "log.h"
 
 
-#define UART_RX_QUEUE_LEN 128
+#define UART_RX_BUFFER_SIZE 512
+#define UART_RX_CHUNK       32  /* bytes moved per xStreamBufferSendFromISR */
+#define UART_TX_RING_SIZE   2048 /* must be a power of two */
+#define UART_TX_QUEUE_LEN   16   /* must be a power of two */
 
 
-static QueueHandle_t     uart_rx_queue = NULL;
-static SemaphoreHandle_t uart_tx_mutex = NULL;
-static SemaphoreHandle_t uart_tx_sem   = NULL;
+volatile uart_stats_t uart_stats;
+
+static StreamBufferHandle_t uart_rx_stream = NULL;
+static SemaphoreHandle_t    uart_tx_mutex  = NULL;
+static SemaphoreHandle_t    uart_tx_sem    = NULL;
+
+
+/* TX descriptor queue. The descriptor at tx_queue_tail is in flight while
+ * tx_busy is set: its completion interrupt calls its done callback and starts
+ * the next one, so back to back transfers never wake a task. */
+typedef struct {
+	const char     *ptr;
+	size_t          len;
+	uart_tx_done_t  done;
+	void           *arg;
+} uart_tx_desc_t;
+
+static uart_tx_desc_t    tx_queue[UART_TX_QUEUE_LEN];
+static volatile uint32_t tx_queue_head;
+static volatile uint32_t tx_queue_tail;
+static volatile int      tx_busy;
+static volatile int      tx_waiting; /* a writer waits on uart_tx_sem for room */
+
+/* Coalescing ring for uart_write(): bytes are released when the transfer
+ * that sent them completes. Writes that land right after the last queued,
+ * not yet started, ring descriptor extend it instead of adding another. */
+static char              tx_ring[UART_TX_RING_SIZE];
+static uint32_t          tx_ring_head;
+static volatile uint32_t tx_ring_tail;
 
 
 void uart_rx_interrupt_handler()
 {
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-	char c;
+	char chunk[UART_RX_CHUNK];
+	size_t n = 0;
 
 	while (UART->SR & UART_SR_RXNE) {
-		c = UART->DATA;
-		xQueueSendFromISR(uart_rx_queue, &c, &xHigherPriorityTaskWoken);
+		chunk[n++] = UART->DATA;
+		if (n == UART_RX_CHUNK) {
+			uart_stats.rx_dropped += n - xStreamBufferSendFromISR(uart_rx_stream, chunk, n, &xHigherPriorityTaskWoken);
+			uart_stats.rx_bytes += n;
+			n = 0;
+		}
+	}
+	if (n) {
+		uart_stats.rx_dropped += n - xStreamBufferSendFromISR(uart_rx_stream, chunk, n, &xHigherPriorityTaskWoken);
+		uart_stats.rx_bytes += n;
 	}
 
 	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
 
 
+/* Start the next queued transfer. Interrupts must be masked. */
+static void uart_tx_start()
+{
+	if (tx_busy || tx_queue_tail == tx_queue_head)
+		return;
+	const uart_tx_desc_t *d = &tx_queue[tx_queue_tail & (UART_TX_QUEUE_LEN - 1)];
+	tx_busy = 1;
+	UART->TX_DMA_ADDR = d->ptr;
+	UART->TX_DMA_SIZE = d->len;
+	UART->CR |= UART_CR_TXDMASTART;
+	UART->CR |= UART_CR_TXIE;
+}
+
+
 void uart_tx_interrupt_handler()
 {
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
 	UART->CR &= ~UART_CR_TXIE;
-	xSemaphoreGiveFromISR(uart_tx_sem, &xHigherPriorityTaskWoken);
+
+	if (tx_busy) {
+		const uart_tx_desc_t *d = &tx_queue[tx_queue_tail & (UART_TX_QUEUE_LEN - 1)];
+		uart_stats.tx_bytes += d->len;
+		uart_stats.tx_transfers++;
+		if (d->done)
+			d->done(d->arg, d->len);
+		tx_queue_tail++;
+		tx_busy = 0;
+		uart_tx_start();
+	}
+
+	if (tx_waiting) {
+		tx_waiting = 0;
+		xSemaphoreGiveFromISR(uart_tx_sem, &xHigherPriorityTaskWoken);
+	}
 	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
 
 
+static void tx_ring_release(void *arg, size_t len)
+{
+	(void)arg;
+	tx_ring_tail += len;
+}
+
+
+/* Queue a descriptor and kick the DMA if idle. Interrupts must be masked.
+ * Returns 0 when the queue is full. */
+static int uart_tx_queue(const char *ptr, size_t len, uart_tx_done_t done, void *arg)
+{
+	uint32_t depth = tx_queue_head - tx_queue_tail;
+	if (depth == UART_TX_QUEUE_LEN)
+		return 0;
+	uart_tx_desc_t *d = &tx_queue[tx_queue_head & (UART_TX_QUEUE_LEN - 1)];
+	d->ptr  = ptr;
+	d->len  = len;
+	d->done = done;
+	d->arg  = arg;
+	tx_queue_head++;
+	if (depth + 1 > uart_stats.tx_queue_max)
+		uart_stats.tx_queue_max = depth + 1;
+	uart_tx_start();
+	return 1;
+}
+
+
 ssize_t uart_read(char *ptr, size_t len)
 {
 	if (len <= 0)
 		return 0;
 
-	ssize_t r = 0;
-
-	if (xQueueReceive(uart_rx_queue, &ptr[0], portMAX_DELAY) == pdTRUE) {
-		r = 1;
-		while ((size_t)r < len) {
-			if (xQueueReceive(uart_rx_queue, &ptr[r], 0) == pdTRUE)
-				r++;
-			else
-				break;
-		}
-	}
+	/* Blocks for the first byte, then takes whatever else is available */
+	ssize_t r = xStreamBufferReceive(uart_rx_stream, ptr, len, portMAX_DELAY);
 
 	if (r < (ssize_t)len)
 		ptr[r] = '\0';
@@ -76,13 +164,47 @@ static ssize_t uart_write_no_OS(const char *ptr, size_t len)
 }
 
 
+/* Copy into the coalescing ring, waiting only when it (or the descriptor
+ * queue) is full */
 static ssize_t uart_write_with_OS(const char *ptr, size_t len)
 {
-	UART->TX_DMA_ADDR = ptr;
-	UART->TX_DMA_SIZE = len;
-	UART->CR |= UART_CR_TXDMASTART;
-	UART->CR |= UART_CR_TXIE;
-	xSemaphoreTake(uart_tx_sem, portMAX_DELAY);
+	size_t done = 0;
+
+	uart_stats.tx_writes++;
+	while (done < len) {
+		taskENTER_CRITICAL();
+		uint32_t start = tx_ring_head & (UART_TX_RING_SIZE - 1);
+		size_t n = len - done;
+		size_t space = UART_TX_RING_SIZE - (tx_ring_head - tx_ring_tail);
+		if (n > space)
+			n = space;
+		if (n > UART_TX_RING_SIZE - start)
+			n = UART_TX_RING_SIZE - start;
+
+		/* Extend the last descriptor when it is a queued ring span ending here */
+		uart_tx_desc_t *last = &tx_queue[(tx_queue_head - 1) & (UART_TX_QUEUE_LEN - 1)];
+		int pending = tx_queue_head - tx_queue_tail - tx_busy;
+		int extend = pending > 0 && last->done == tx_ring_release &&
+		             last->ptr + last->len == &tx_ring[start];
+
+		if (n > 0 && (extend || tx_queue_head - tx_queue_tail < UART_TX_QUEUE_LEN)) {
+			memcpy(&tx_ring[start], ptr + done, n);
+			tx_ring_head += n;
+			done += n;
+			if (extend) {
+				last->len += n;
+				uart_stats.tx_coalesced++;
+			} else {
+				uart_tx_queue(&tx_ring[start], n, tx_ring_release, NULL);
+			}
+			taskEXIT_CRITICAL();
+		} else {
+			tx_waiting = 1;
+			uart_stats.tx_waits++;
+			taskEXIT_CRITICAL();
+			xSemaphoreTake(uart_tx_sem, portMAX_DELAY);
+		}
+	}
 	return len;
 }
 
@@ -103,11 +225,60 @@ ssize_t uart_write(const char *ptr, size_t len)
 }
 
 
+int uart_write_zero_copy(const char *ptr, size_t len, uart_tx_done_t done, void *arg)
+{
+	uint32_t state = minirisc_save_and_disable_interrupts();
+	int r = uart_tx_queue(ptr, len, done, arg);
+	if (r)
+		uart_stats.tx_writes++;
+	minirisc_restore_interrupts(state);
+	return r;
+}
+
+
+void uart_flush()
+{
+	while (tx_queue_head != tx_queue_tail)
+		vTaskDelay(1);
+}
+
+
+#ifdef UART_RX_BENCHMARK
+/* Receive nbytes as fast as possible and report the throughput. Run it
+ * under Harvey with the UART input fed from a file on the host. The clock
+ * starts when the first read returns: the bytes of that read arrived before
+ * it and are left out of the rate. */
+void uart_rx_benchmark(size_t nbytes)
+{
+	static char buffer[UART_RX_BUFFER_SIZE];
+	size_t total = 0, first = 0;
+	uint32_t reads = 0;
+	uint64_t start = 0;
+
+	while (total < nbytes) {
+		ssize_t n = uart_read(buffer, sizeof(buffer));
+		if (total == 0) {
+			start = RTC->NSEC;
+			first = n;
+		}
+		total += n;
+		reads++;
+	}
+	uint64_t ns = RTC->NSEC - start;
+	if (ns == 0)
+		ns = 1;
+	log_info("UART RX: %u bytes in %u reads, %u us, %u bytes/s, %u dropped\n",
+	         (uint32_t)total, reads, (uint32_t)(ns / 1000),
+	         (uint32_t)((total - first) * 1000000000ULL / ns), uart_stats.rx_dropped);
+}
+#endif
+
+
 void init_uart()
 {
-	uart_tx_mutex = xSemaphoreCreateMutex();
-	uart_tx_sem   = xSemaphoreCreateBinary();
-	uart_rx_queue = xQueueCreate(UART_RX_QUEUE_LEN, sizeof(char));
+	uart_tx_mutex  = xSemaphoreCreateMutex();
+	uart_tx_sem    = xSemaphoreCreateBinary();
+	uart_rx_stream = xStreamBufferCreate(UART_RX_BUFFER_SIZE, 1);
 
 	UART->CR = UART_CR_RXIE;
 
@@ -1,10 +1,44 @@
 #ifndef UART_H
 #define UART_H
 
+#include <stdint.h>
 #include <sys/types.h>
 
+/* TX: uart_write() copies into a coalescing ring and returns, it only blocks
+ * when the ring is full. uart_write_zero_copy() queues the caller's buffer
+ * itself and calls done(arg, len) from the TX interrupt once it is sent.
+ * Transfers are chained by the TX interrupt, in order.
+ * RX: bytes are moved in bulk from the RX interrupt into a stream buffer.
+ */
+
+typedef void (*uart_tx_done_t)(void *arg, size_t len);
+
+typedef struct {
+	uint32_t tx_bytes;     /* bytes sent */
+	uint32_t tx_transfers; /* DMA transfers */
+	uint32_t tx_writes;    /* uart_write and uart_write_zero_copy calls */
+	uint32_t tx_coalesced; /* writes merged into an already queued transfer */
+	uint32_t tx_waits;     /* writes that had to wait for room */
+	uint32_t tx_queue_max; /* deepest descriptor queue seen */
+	uint32_t rx_bytes;     /* bytes received */
+	uint32_t rx_dropped;   /* bytes lost because the stream buffer was full */
+} uart_stats_t;
+
+extern volatile uart_stats_t uart_stats;
+
 void    init_uart();
 ssize_t uart_read(char *ptr, size_t len);
 ssize_t uart_write(const char *ptr, size_t len);
 
+/* Wait until everything queued has been sent. Log messages the log task has
+ * not queued yet are not waited for: log_flush() queues them first. */
+void    uart_flush();
+
+/* Non-blocking, usable from ISRs. Returns 0 when the descriptor queue is full. */
+int     uart_write_zero_copy(const char *ptr, size_t len, uart_tx_done_t done, void *arg);
+
+#ifdef UART_RX_BENCHMARK
+void    uart_rx_benchmark(size_t nbytes);
+#endif
+
 #endif /* UART_H */
@@ -0,0 +1,512 @@
+#include <string.h>
+#include "tetris.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#define SHAPE_ENTRY(kicks, rotations) { rotations },
+#define ROT_CELLS(x0,y0, x1,y1, x2,y2, x3,y3) {{x0,y0}, {x1,y1}, {x2,y2}, {x3,y3}},
+
+int shapes[NUM_SHAPES][4][4][2] = {
+    TETROMINOES(SHAPE_ENTRY, ROT_CELLS)
+};
+
+#define MIN2(a, b) ((a) < (b) ? (a) : (b))
+#define MAX2(a, b) ((a) > (b) ? (a) : (b))
+#define MIN4(a, b, c, d) MIN2(MIN2(a, b), MIN2(c, d))
+#define MAX4(a, b, c, d) MAX2(MAX2(a, b), MAX2(c, d))
+#define CELL_ROW_BIT(r, x, y) ((y) == (r) ? 1u << (x) : 0u)
+#define ROT_ROW(r, x0,y0, x1,y1, x2,y2, x3,y3) \
+    (CELL_ROW_BIT(r, x0, y0) | CELL_ROW_BIT(r, x1, y1) | CELL_ROW_BIT(r, x2, y2) | CELL_ROW_BIT(r, x3, y3))
+#define CELL_COL_Y(c, x, y) ((x) == (c) ? (y) : -1)
+#define ROT_COL_BOTTOM(c, x0,y0, x1,y1, x2,y2, x3,y3) \
+    MAX4(CELL_COL_Y(c, x0, y0), CELL_COL_Y(c, x1, y1), CELL_COL_Y(c, x2, y2), CELL_COL_Y(c, x3, y3))
+#define ROT_MASK(...) \
+    {{ROT_ROW(0, __VA_ARGS__), ROT_ROW(1, __VA_ARGS__), ROT_ROW(2, __VA_ARGS__), ROT_ROW(3, __VA_ARGS__)}, \
+     ROT_BBOX(__VA_ARGS__), \
+     {ROT_COL_BOTTOM(0, __VA_ARGS__), ROT_COL_BOTTOM(1, __VA_ARGS__), \
+      ROT_COL_BOTTOM(2, __VA_ARGS__), ROT_COL_BOTTOM(3, __VA_ARGS__)}},
+#define ROT_BBOX(x0,y0, x1,y1, x2,y2, x3,y3) \
+    MIN4(x0, x1, x2, x3), MAX4(x0, x1, x2, x3), MIN4(y0, y1, y2, y3), MAX4(y0, y1, y2, y3)
+
+const shape_mask_t shape_masks[NUM_SHAPES][4] = {
+    TETROMINOES(SHAPE_ENTRY, ROT_MASK)
+};
+
+// SRS wall kicks: offsets tried in order when rotating from state `from`,
+// [0] clockwise and [1] counter-clockwise. They are written with y up as in the
+// SRS tables and stored with y down like the board.
+#define NUM_KICKS 5
+#define K(x, y) {x, -(y)}
+enum { KICKS_NONE, KICKS_JLSTZ, KICKS_I, NUM_KICK_SETS };
+
+static const int8_t kick_table[NUM_KICK_SETS][4][2][NUM_KICKS][2] = {
+    [KICKS_NONE] = {{{{0}}}},
+    [KICKS_JLSTZ] = {
+        /* 0 */ {{K(0,0), K(-1,0), K(-1, 1), K(0,-2), K(-1,-2)},   // 0->R
+                 {K(0,0), K( 1,0), K( 1, 1), K(0,-2), K( 1,-2)}},  // 0->L
+        /* R */ {{K(0,0), K( 1,0), K( 1,-1), K(0, 2), K( 1, 2)},   // R->2
+                 {K(0,0), K( 1,0), K( 1,-1), K(0, 2), K( 1, 2)}},  // R->0
+        /* 2 */ {{K(0,0), K( 1,0), K( 1, 1), K(0,-2), K( 1,-2)},   // 2->L
+                 {K(0,0), K(-1,0), K(-1, 1), K(0,-2), K(-1,-2)}},  // 2->R
+        /* L */ {{K(0,0), K(-1,0), K(-1,-1), K(0, 2), K(-1, 2)},   // L->0
+                 {K(0,0), K(-1,0), K(-1,-1), K(0, 2), K(-1, 2)}},  // L->2
+    },
+    [KICKS_I] = {
+        /* 0 */ {{K(0,0), K(-2,0), K( 1,0), K(-2,-1), K( 1, 2)},   // 0->R
+                 {K(0,0), K(-1,0), K( 2,0), K(-1, 2), K( 2,-1)}},  // 0->L
+        /* R */ {{K(0,0), K(-1,0), K( 2,0), K(-1, 2), K( 2,-1)},   // R->2
+                 {K(0,0), K( 2,0), K(-1,0), K( 2, 1), K(-1,-2)}},  // R->0
+        /* 2 */ {{K(0,0), K( 2,0), K(-1,0), K( 2, 1), K(-1,-2)},   // 2->L
+                 {K(0,0), K( 1,0), K(-2,0), K( 1,-2), K(-2, 1)}},  // 2->R
+        /* L */ {{K(0,0), K( 1,0), K(-2,0), K( 1,-2), K(-2, 1)},   // L->0
+                 {K(0,0), K(-2,0), K( 1,0), K(-2,-1), K( 1, 2)}},  // L->2
+    },
+};
+
+#define SHAPE_KICKS(kicks, rotations) kicks,
+static const uint8_t shape_kick_set[NUM_SHAPES] = {
+    TETROMINOES(SHAPE_KICKS, ROT_CELLS)
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+TETRIS_TLS game_state_t game_state;
+TETRIS_TLS uint32_t tetris_tick;
+TETRIS_TLS uint32_t tetris_games;
+TETRIS_TLS uint16_t board_damage[BOARD_HEIGHT];
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void mark_cell_dirty(int x, int y) {
+    if (x >= 0 && x < BOARD_WIDTH && y >= 0 && y < BOARD_HEIGHT) {
+        board_damage[y] |= 1 << x;
+    }
+}
+
+// Mark the cells covered by the falling piece at its current position and by
+// its ghost on the landing row
+static void mark_shape_dirty() {
+    for (int i = 0; i < 4; i++) {
+        mark_cell_dirty(game_state.current_x + game_state.current_shape[i][0],
+                        game_state.current_y + game_state.current_shape[i][1]);
+        mark_cell_dirty(game_state.current_x + game_state.current_shape[i][0],
+                        game_state.ghost_y + game_state.current_shape[i][1]);
+    }
+}
+
+// The falling piece moved, rotated or spawned: update its ghost and repaint.
+// Moving a grounded piece restarts its lock delay, a limited number of times
+// per row reached: wall kicks can lift the piece, only a new lowest row
+// grants more restarts.
+static void shape_moved() {
+    game_state.ghost_y = landing_y(game_state.current_shape_type, game_state.current_rotation,
+                                   game_state.current_x, game_state.current_y);
+    mark_shape_dirty();
+    if (game_state.current_y > game_state.lowest_y) {
+        game_state.lowest_y = game_state.current_y;
+        game_state.lock_resets = 0;
+    }
+    if (game_state.current_y == game_state.ghost_y &&
+        game_state.lock_resets < TETRIS_MAX_LOCK_RESETS) {
+        game_state.lock_timer = 0;
+        game_state.lock_resets++;
+    }
+}
+
+// Mark every cell of rows [0, y_last], e.g. everything shifted by a line clear
+static void mark_rows_dirty(int y_last) {
+    for (int y = 0; y <= y_last && y < BOARD_HEIGHT; y++) {
+        board_damage[y] = BOARD_FULL_ROW;
+    }
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Collision test of a rotation placed at (x, y): a bounding box check against
+// the walls and floor, then one AND per occupied row. Rows above the board are
+// free, like in the original per-cell checks.
+int shape_collides(int type, int rotation, int x, int y) {
+    const shape_mask_t *m = &shape_masks[type][rotation];
+    if (x + m->x_min < 0 || x + m->x_max >= BOARD_WIDTH || y + m->y_max >= BOARD_HEIGHT) {
+        return 1;
+    }
+    for (int r = m->y_min; r <= m->y_max; r++) {
+        if (y + r >= 0 && (game_state.board_rows[y + r] & shape_row(m, r, x))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Row where a piece dropped straight down from (x, y) comes to rest. Every
+// column of the piece stops one row above the top block of its board column,
+// the piece lands at the highest of those rows. That only holds when the piece
+// is above all those blocks: after sliding under an overhang it is probed down.
+int landing_y(int type, int rotation, int x, int y) {
+    const shape_mask_t *m = &shape_masks[type][rotation];
+    int land = BOARD_HEIGHT;
+    for (int c = m->x_min; c <= m->x_max; c++) {
+        int top = BOARD_HEIGHT - game_state.col_height[x + c];
+        int col_land = top - 1 - m->col_bottom[c];
+        if (col_land < land) {
+            land = col_land;
+        }
+    }
+    if (land >= y) {
+        return land;
+    }
+    while (!shape_collides(type, rotation, x, y + 1)) {
+        y++;
+    }
+    return y;
+}
+
+// Recompute the column heights after rows were removed
+static void update_col_heights() {
+    uint16_t seen = 0;
+    memset(game_state.col_height, 0, sizeof(game_state.col_height));
+    for (int y = 0; y < BOARD_HEIGHT && seen != BOARD_FULL_ROW; y++) {
+        uint16_t top = game_state.board_rows[y] & ~seen;
+        seen |= top;
+        for (int x = 0; top; x++, top >>= 1) {
+            if (top & 1) {
+                game_state.col_height[x] = BOARD_HEIGHT - y;
+            }
+        }
+    }
+}
+
+// Rotate with SRS wall kicks: the first kick offset where the new state fits
+// wins, the rotation is rejected when none does
+void rotate_shape(int dir) {
+    int type = game_state.current_shape_type;
+    int from = game_state.current_rotation;
+    int to = (from + dir) & 3;
+    const int8_t (*kicks)[2] = kick_table[shape_kick_set[type]][from][dir < 0];
+    
+    for (int i = 0; i < NUM_KICKS; i++) {
+        int x = game_state.current_x + kicks[i][0];
+        int y = game_state.current_y + kicks[i][1];
+        if (!shape_collides(type, to, x, y)) {
+            mark_shape_dirty();
+            game_state.current_rotation = to;
+            game_state.current_x = x;
+            game_state.current_y = y;
+            memcpy(game_state.current_shape, shapes[type][to], sizeof(game_state.current_shape));
+            shape_moved();
+            return;
+        }
+    }
+}
+
+
+int can_move(int dx, int dy) {
+    return !shape_collides(game_state.current_shape_type, game_state.current_rotation,
+                           game_state.current_x + dx, game_state.current_y + dy);
+}
+
+// Add the falling piece to the board (its cells are already dirty), clear the
+// lines it completed and bring in the next piece
+static void lock_shape() {
+    const shape_mask_t *m = &shape_masks[game_state.current_shape_type][game_state.current_rotation];
+    for (int r = m->y_min; r <= m->y_max; r++) {
+        int y = game_state.current_y + r;
+        if (y < 0) {
+            continue;
+        }
+        uint16_t row = shape_row(m, r, game_state.current_x);
+        game_state.board_rows[y] |= row;
+        for (int x = 0; row; x++, row >>= 1) {
+            if (row & 1) {
+                game_state.board_colors[y][x] = game_state.current_shape_type + 1;
+                game_state.row_fill[y]++;
+                if (game_state.col_height[x] < BOARD_HEIGHT - y) {
+                    game_state.col_height[x] = BOARD_HEIGHT - y;
+                }
+            }
+        }
+    }
+    
+    // Only the rows the piece landed in can have been completed
+    check_line_clear(game_state.current_y + m->y_min, game_state.current_y + m->y_max);
+    
+    // Spawn new shape
+    spawn_shape();
+}
+
+// A piece that cannot go down is not locked here: see the lock delay in tetris_step()
+int move_shape(int dx, int dy) {
+    if (!can_move(dx, dy)) {
+        return 0;
+    }
+    mark_shape_dirty();
+    game_state.current_x += dx;
+    game_state.current_y += dy;
+    shape_moved();
+    return 1;
+}
+
+// Drop the piece straight to its ghost and lock it
+void hard_drop() {
+    mark_shape_dirty();
+    game_state.current_y = game_state.ghost_y;
+    mark_shape_dirty();
+    lock_shape();
+}
+
+// Random integer in [0, n) by multiply-shift, which avoids a division
+static int queue_rand(piece_queue_t *q, int n) {
+    return (int)(((uint64_t)tetris_rand(&q->rng) * n) >> 32);
+}
+
+// Next piece of the 7-bag: each bag is a Fisher-Yates shuffle of all shapes
+static int queue_draw_bag(piece_queue_t *q) {
+    if (q->bag_pos == NUM_SHAPES) {
+        for (int i = 0; i < NUM_SHAPES; i++) {
+            q->bag[i] = i;
+        }
+        for (int i = NUM_SHAPES - 1; i > 0; i--) {
+            int j = queue_rand(q, i + 1);
+            uint8_t t = q->bag[i];
+            q->bag[i] = q->bag[j];
+            q->bag[j] = t;
+        }
+        q->bag_pos = 0;
+    }
+    return q->bag[q->bag_pos++];
+}
+
+static void queue_init(piece_queue_t *q, uint32_t seed) {
+    q->rng = seed ? seed : 0x9E3779B9; // xorshift is stuck at zero
+    q->bag_pos = NUM_SHAPES;
+    for (int i = 0; i < TETRIS_PREVIEW; i++) {
+        q->preview[i] = queue_draw_bag(q);
+    }
+    q->preview_head = 0;
+}
+
+// Take the head of the preview and refill its slot from the bag
+static int queue_next(piece_queue_t *q) {
+    int type = q->preview[q->preview_head];
+    q->preview[q->preview_head] = queue_draw_bag(q);
+    q->preview_head = (q->preview_head + 1) % TETRIS_PREVIEW;
+    return type;
+}
+
+void spawn_shape() {
+    game_state.current_shape_type = queue_next(&game_state.queue);
+    game_state.current_rotation = 0;
+    
+    // Start at top center
+    game_state.current_x = BOARD_WIDTH / 2 - 2;
+    game_state.current_y = 0;
+    
+    // Check for game over
+    if (shape_collides(game_state.current_shape_type, 0,
+                       game_state.current_x, game_state.current_y)) {
+        // Game over reset, the piece stream and the keys carry on
+        piece_queue_t queue = game_state.queue;
+        key_state_t keys = game_state.keys;
+        int type = game_state.current_shape_type;
+        memset(&game_state, 0, sizeof(game_state));
+        game_state.queue = queue;
+        game_state.keys = keys;
+        game_state.current_shape_type = type;
+        mark_rows_dirty(BOARD_HEIGHT - 1);
+        tetris_games++;
+    }
+    
+    // Copy initial shape configuration
+    memcpy(game_state.current_shape, 
+           shapes[game_state.current_shape_type][0], 
+           sizeof(game_state.current_shape));
+    game_state.lowest_y = game_state.current_y;
+    shape_moved();
+    game_state.lock_timer = 0;
+    game_state.lock_resets = 0;
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Remove the completed rows among [y_first, y_last]. Called when a piece
+// locks, with the rows it occupies: no other row can have changed.
+// Single-pass compaction: walking up from y_last, every surviving row is
+// written once to its final position, whatever the number of lines cleared.
+void check_line_clear(int y_first, int y_last) {
+    int lines_cleared = 0;
+    if (y_first < 0) {
+        y_first = 0;
+    }
+    
+    int dst = y_last;
+    int src = y_last;
+    for (; src >= y_first; src--) {
+        if (game_state.row_fill[src] == BOARD_WIDTH) {
+            lines_cleared++;
+        } else {
+            if (dst != src) {
+                game_state.board_rows[dst] = game_state.board_rows[src];
+                game_state.row_fill[dst] = game_state.row_fill[src];
+                memcpy(game_state.board_colors[dst], game_state.board_colors[src],
+                       sizeof(game_state.board_colors[0]));
+            }
+            dst--;
+        }
+    }
+    if (lines_cleared == 0) {
+        return;
+    }
+    
+    // Rows above the piece all move down by lines_cleared: one block move each
+    memmove(&game_state.board_rows[lines_cleared], &game_state.board_rows[0],
+            (src + 1) * sizeof(game_state.board_rows[0]));
+    memmove(&game_state.board_colors[lines_cleared], &game_state.board_colors[0],
+            (src + 1) * sizeof(game_state.board_colors[0]));
+    memmove(&game_state.row_fill[lines_cleared], &game_state.row_fill[0],
+            (src + 1) * sizeof(game_state.row_fill[0]));
+    
+    // Clear the top lines
+    memset(game_state.board_rows, 0, lines_cleared * sizeof(game_state.board_rows[0]));
+    memset(game_state.board_colors, 0, lines_cleared * sizeof(game_state.board_colors[0]));
+    memset(game_state.row_fill, 0, lines_cleared * sizeof(game_state.row_fill[0]));
+    mark_rows_dirty(y_last);
+    update_col_heights();
+    
+    // Update score
+    static int score_multiplier[] = {0, 40, 100, 300, 1200};
+    game_state.score += score_multiplier[lines_cleared] * (game_state.level + 1);
+    game_state.lines_cleared += lines_cleared;
+    game_state.level = game_state.lines_cleared / 10;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void tetris_init(uint32_t seed) {
+    memset(&game_state, 0, sizeof(game_state));
+    tetris_tick = 0;
+    tetris_games = 0;
+    queue_init(&game_state.queue, seed);
+    game_state.keys.das_action = -1;
+    mark_rows_dirty(BOARD_HEIGHT - 1);
+    spawn_shape();
+}
+
+void tetris_action(tetris_action_t action) {
+    switch (action) {
+        case ACTION_LEFT:
+            move_shape(-1, 0);
+            break;
+        case ACTION_RIGHT:
+            move_shape(1, 0);
+            break;
+        case ACTION_ROTATE:
+            rotate_shape(1);
+            break;
+        case ACTION_ROTATE_CCW:
+            rotate_shape(-1);
+            break;
+        case ACTION_SOFT_DROP:
+            move_shape(0, 1);
+            break;
+        case ACTION_HARD_DROP:
+            hard_drop();
+            break;
+        default:
+            break;
+    }
+}
+
+// Gravity: simulation steps per row for each level
+#define DROP_STEPS(ms) ((ms) / TETRIS_STEP_MS)
+static const uint8_t gravity_steps[TETRIS_MAX_LEVEL + 1] = {
+    DROP_STEPS(500), DROP_STEPS(450), DROP_STEPS(400), DROP_STEPS(350),
+    DROP_STEPS(300), DROP_STEPS(250), DROP_STEPS(200), DROP_STEPS(170),
+    DROP_STEPS(140), DROP_STEPS(110), DROP_STEPS(90),  DROP_STEPS(70),
+    DROP_STEPS(50),  DROP_STEPS(40),  DROP_STEPS(30),  DROP_STEPS(20),
+};
+
+void tetris_press(tetris_action_t action) {
+    game_state.keys.held |= ACTION_BIT(action);
+    game_state.keys.pressed |= ACTION_BIT(action);
+}
+
+void tetris_release(tetris_action_t action) {
+    game_state.keys.held &= ~ACTION_BIT(action);
+}
+
+#define DAS_STEPS       (TETRIS_DAS_MS / TETRIS_STEP_MS)
+#define ARR_STEPS       (TETRIS_ARR_MS / TETRIS_STEP_MS)
+#define SOFT_DROP_STEPS (TETRIS_SOFT_DROP_MS / TETRIS_STEP_MS)
+#define LOCK_STEPS      (TETRIS_LOCK_MS / TETRIS_STEP_MS)
+
+// Keys pressed since the last step act once, held keys auto-repeat: the last
+// side move pressed repeats after DAS_STEPS then every ARR_STEPS, soft drop
+// every SOFT_DROP_STEPS.
+static void step_keys() {
+    key_state_t *k = &game_state.keys;
+    uint8_t pressed = k->pressed;
+    k->pressed = 0;
+    
+    for (int a = 0; a < NUM_ACTIONS; a++) {
+        if (pressed & ACTION_BIT(a)) {
+            tetris_action(a);
+        }
+    }
+    
+    // Delayed auto shift
+    if (pressed & ACTION_BIT(ACTION_LEFT)) {
+        k->das_action = ACTION_LEFT;
+        k->das_timer = 0;
+    }
+    if (pressed & ACTION_BIT(ACTION_RIGHT)) {
+        k->das_action = ACTION_RIGHT;
+        k->das_timer = 0;
+    }
+    if (k->das_action >= 0 && !(k->held & ACTION_BIT(k->das_action))) {
+        // Released: fall back to the other direction if it is still held
+        int other = k->das_action == ACTION_LEFT ? ACTION_RIGHT : ACTION_LEFT;
+        k->das_action = (k->held & ACTION_BIT(other)) ? other : -1;
+        k->das_timer = 0;
+    }
+    if (k->das_action >= 0 && !(pressed & ACTION_BIT(k->das_action))) {
+        if (++k->das_timer >= DAS_STEPS) {
+            move_shape(k->das_action == ACTION_LEFT ? -1 : 1, 0);
+            k->das_timer = DAS_STEPS - ARR_STEPS;
+        }
+    }
+    
+    // Soft drop
+    if ((k->held & ACTION_BIT(ACTION_SOFT_DROP)) && !(pressed & ACTION_BIT(ACTION_SOFT_DROP))) {
+        if (++k->soft_drop_timer >= SOFT_DROP_STEPS) {
+            k->soft_drop_timer = 0;
+            move_shape(0, 1);
+        }
+    } else {
+        k->soft_drop_timer = 0;
+    }
+}
+
+void tetris_step() {
+    step_keys();
+    
+    // Game logic: periodic shape drop, faster at higher levels
+    int level = game_state.level < TETRIS_MAX_LEVEL ? game_state.level : TETRIS_MAX_LEVEL;
+    game_state.drop_timer++;
+    if (game_state.drop_timer >= gravity_steps[level]) {
+        game_state.drop_timer = 0;
+        move_shape(0, 1);
+    }
+    
+    // Lock delay: a piece locks after LOCK_STEPS on the ground
+    if (game_state.current_y == game_state.ghost_y) {
+        if (++game_state.lock_timer >= LOCK_STEPS) {
+            lock_shape();
+        }
+    } else {
+        game_state.lock_timer = 0;
+    }
+    
+    tetris_tick++;
+}
+
+uint32_t tetris_checksum() {
+    // FNV-1a over the game state
+    const uint8_t *p = (const uint8_t *)&game_state;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < sizeof(game_state); i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
@@ -0,0 +1,217 @@
+#ifndef TETRIS_H
+#define TETRIS_H
+
+#include <stdint.h>
+
+/* Game core: board, pieces, scoring. This part has no dependency on the
+ * Harvey platform (no MMIO, no FreeRTOS) so that it also builds natively for
+ * the headless simulator (make host). The platform layer in main.c feeds it
+ * actions, calls tetris_step() at a fixed rate and repaints the cells
+ * reported in board_damage.
+ */
+
+#define NUM_SHAPES 7
+/*The board may be any size, although the standard Tetris board is 10 wide and 20 high*/
+#define BOARD_WIDTH 10
+#define BOARD_HEIGHT 20
+
+#define TETRIS_STEP_MS   10  // one simulation step every 10 ms (100 Hz)
+#define TETRIS_MAX_LEVEL 15  // gravity stops speeding up past this level
+#define TETRIS_PREVIEW   5   // number of upcoming pieces kept in the preview
+
+// Input timing, applied by tetris_step() to the keys held down
+#ifndef TETRIS_DAS_MS
+#define TETRIS_DAS_MS       170 // delayed auto shift: hold time before a side move repeats
+#endif
+#ifndef TETRIS_ARR_MS
+#define TETRIS_ARR_MS       50  // auto repeat rate of side moves once DAS has elapsed
+#endif
+#ifndef TETRIS_SOFT_DROP_MS
+#define TETRIS_SOFT_DROP_MS 30  // one row per 30 ms while soft drop is held
+#endif
+#ifndef TETRIS_LOCK_MS
+#define TETRIS_LOCK_MS      500 // lock delay: time a grounded piece can still move
+#endif
+#ifndef TETRIS_MAX_LOCK_RESETS
+#define TETRIS_MAX_LOCK_RESETS 15 // moves that restart the lock delay, per row reached
+#endif
+
+// Tetromino shapes with 4 rotations for each // 1 cte color for each 
+// Each rotation is written once as its four (x, y) cells, y pointing down. Both
+// the coordinate table and the per-row collision masks are expanded from this
+// list by the preprocessor, so adding a piece never needs a hand-maintained mask.
+// Rotations follow the Super Rotation System: states 0, R, 2, L in clockwise
+// order inside a 4x4 (I, O) or 3x3 box, with the wall kick set of each piece.
+#define TETROMINOES(SHAPE, ROT) \
+    /* I-shape */ \
+    SHAPE(KICKS_I, \
+          ROT(0,1, 1,1, 2,1, 3,1) \
+          ROT(2,0, 2,1, 2,2, 2,3) \
+          ROT(0,2, 1,2, 2,2, 3,2) \
+          ROT(1,0, 1,1, 1,2, 1,3)) \
+    /* O-shape (pas de rotation) */ \
+    SHAPE(KICKS_NONE, \
+          ROT(1,0, 2,0, 1,1, 2,1) \
+          ROT(1,0, 2,0, 1,1, 2,1) \
+          ROT(1,0, 2,0, 1,1, 2,1) \
+          ROT(1,0, 2,0, 1,1, 2,1)) \
+    /* T-shape */ \
+    SHAPE(KICKS_JLSTZ, \
+          ROT(1,0, 0,1, 1,1, 2,1) \
+          ROT(1,0, 1,1, 2,1, 1,2) \
+          ROT(0,1, 1,1, 2,1, 1,2) \
+          ROT(1,0, 0,1, 1,1, 1,2)) \
+    /* L-shape */ \
+    SHAPE(KICKS_JLSTZ, \
+          ROT(2,0, 0,1, 1,1, 2,1) \
+          ROT(1,0, 1,1, 1,2, 2,2) \
+          ROT(0,1, 1,1, 2,1, 0,2) \
+          ROT(0,0, 1,0, 1,1, 1,2)) \
+    /* Reverse L-shape */ \
+    SHAPE(KICKS_JLSTZ, \
+          ROT(0,0, 0,1, 1,1, 2,1) \
+          ROT(1,0, 2,0, 1,1, 1,2) \
+          ROT(0,1, 1,1, 2,1, 2,2) \
+          ROT(1,0, 1,1, 0,2, 1,2)) \
+    /* S-shape */ \
+    SHAPE(KICKS_JLSTZ, \
+          ROT(1,0, 2,0, 0,1, 1,1) \
+          ROT(1,0, 1,1, 2,1, 2,2) \
+          ROT(1,1, 2,1, 0,2, 1,2) \
+          ROT(0,0, 0,1, 1,1, 1,2)) \
+    /* Z-shape */ \
+    SHAPE(KICKS_JLSTZ, \
+          ROT(0,0, 1,0, 1,1, 2,1) \
+          ROT(2,0, 1,1, 2,1, 1,2) \
+          ROT(0,1, 1,1, 1,2, 2,2) \
+          ROT(1,0, 0,1, 1,1, 0,2))
+
+// Per-rotation collision masks: rows[r] has bit x set when cell (x, r) of the
+// rotation is filled, the bounding box limits the rows and columns to test.
+// col_bottom[c] is the lowest filled row of column c (-1 when empty), used to
+// find the landing row from the column heights.
+typedef struct {
+    uint16_t rows[4];
+    int8_t x_min, x_max, y_min, y_max;
+    int8_t col_bottom[4];
+} shape_mask_t;
+
+extern int shapes[NUM_SHAPES][4][4][2];
+extern const shape_mask_t shape_masks[NUM_SHAPES][4];
+
+// Game state structure
+// The board is stored row-major as one occupancy bitmask per row (bit x set when
+// cell (x, y) is filled) plus a separate color plane, so collisions and full-row
+// tests are mask operations and a line clear is a single memmove.
+#define BOARD_FULL_ROW ((uint16_t)((1 << BOARD_WIDTH) - 1))
+#define CELL_OCCUPIED(x, y) (game_state.board_rows[y] & (1 << (x)))
+
+// Piece randomizer: a xorshift32 generator drawing pieces from shuffled bags
+// of all seven shapes, followed by a ring of the next TETRIS_PREVIEW pieces.
+// The whole piece stream is a function of the seed given to tetris_init().
+typedef struct {
+    uint32_t rng;
+    uint8_t bag[NUM_SHAPES];
+    uint8_t bag_pos;                 // next piece to take from the bag
+    uint8_t preview[TETRIS_PREVIEW];
+    uint8_t preview_head;            // index of the next piece to spawn
+} piece_queue_t;
+
+// Key state, one bit per tetris_action_t. A key pressed and released between
+// two steps still acts once since its pressed bit stays set until the step.
+typedef struct {
+    uint8_t held;    // actions whose key is down
+    uint8_t pressed; // actions pressed since the last step
+    int das_action;  // side move being auto-shifted, -1 when none
+    int das_timer;
+    int soft_drop_timer;
+} key_state_t;
+
+typedef struct {
+    uint16_t board_rows[BOARD_HEIGHT]; // occupancy bitmask, size standart de tetris
+    uint8_t board_colors[BOARD_HEIGHT][BOARD_WIDTH]; // shape type + 1, 0 when empty
+    uint8_t row_fill[BOARD_HEIGHT]; // number of occupied cells of each row
+    uint8_t col_height[BOARD_WIDTH]; // rows from the floor to the top block, 0 when empty
+    int current_shape[4][2]; 
+    int current_shape_type;
+    int current_rotation;
+    int current_x, current_y;
+    int ghost_y; // row where the falling piece would land
+    int score;
+    int level;
+    int lines_cleared;
+    int drop_timer; // simulation steps since the last gravity drop
+    int lock_timer; // simulation steps spent on the ground
+    int lock_resets; // lock delay restarts since the piece reached lowest_y
+    int lowest_y; // lowest row the falling piece has reached
+    key_state_t keys;    // kept across game over resets
+    piece_queue_t queue; // kept across game over resets
+} game_state_t;
+
+// Host tools that run several games at once (TETRIS_THREADS) get one copy of
+// the core state per thread. The Harvey build has a single game.
+#ifdef TETRIS_THREADS
+#define TETRIS_TLS __thread
+#else
+#define TETRIS_TLS
+#endif
+
+extern TETRIS_TLS game_state_t game_state;
+extern TETRIS_TLS uint32_t tetris_tick;  // simulation steps since tetris_init()
+extern TETRIS_TLS uint32_t tetris_games; // game over resets since tetris_init()
+
+// Damage tracking: one bit per board column for each row, set whenever the
+// game state changes what a cell should look like. The renderer collects and
+// clears it.
+extern TETRIS_TLS uint16_t board_damage[BOARD_HEIGHT];
+
+typedef enum {
+    ACTION_LEFT,
+    ACTION_RIGHT,
+    ACTION_ROTATE,     // clockwise
+    ACTION_ROTATE_CCW, // counter-clockwise
+    ACTION_SOFT_DROP,
+    ACTION_HARD_DROP,
+    NUM_ACTIONS
+} tetris_action_t;
+
+#define ACTION_BIT(action) (1u << (action))
+
+// Row r of a rotation's mask, shifted to board column x (x may be negative
+// when the leftmost columns of the rotation are empty)
+static inline uint16_t shape_row(const shape_mask_t *m, int r, int x) {
+    return x >= 0 ? m->rows[r] << x : m->rows[r] >> -x;
+}
+
+// xorshift32, state must be non-zero
+static inline uint32_t tetris_rand(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// Shape type of the i-th upcoming piece, 0 being the next one to spawn
+static inline int tetris_preview(int i) {
+    const piece_queue_t *q = &game_state.queue;
+    return q->preview[(q->preview_head + i) % TETRIS_PREVIEW];
+}
+
+void tetris_init(uint32_t seed);
+void tetris_action(tetris_action_t action); // applied at once, no auto repeat
+void tetris_press(tetris_action_t action);   // key down, acts on the next step
+void tetris_release(tetris_action_t action); // key up
+void tetris_step(); // one fixed simulation step: keys, gravity, lock delay
+uint32_t tetris_checksum(); // hash of game_state, to compare runs
+
+int  shape_collides(int type, int rotation, int x, int y);
+int  landing_y(int type, int rotation, int x, int y);
+int  can_move(int dx, int dy);
+int  move_shape(int dx, int dy); // 1 when the piece moved
+void rotate_shape(int dir); // 1: clockwise, -1: counter-clockwise
+void hard_drop();
+void spawn_shape();
+void check_line_clear(int y_first, int y_last);
+
+#endif /* TETRIS_H */
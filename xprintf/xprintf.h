@@ -25,6 +25,7 @@ extern "C" {
 #endif
 
 #if XF_USE_OUTPUT
+#include <stdarg.h>
 //#define xdev_out(func) xfunc_output = (void(*)(int))(func)
 //extern void (*xfunc_output)(int);
 void xputc (int chr);
@@ -34,6 +35,7 @@ void xfputs (void (*func)(int), const char* str);
 void xprintf (const char* fmt, ...);
 void xsprintf (char* buff, const char* fmt, ...);
 void xfprintf (void (*func)(int), const char* fmt, ...);
+void xvfprintf (void (*func)(int), const char* fmt, va_list arp);
 void put_dump (const void* buff, unsigned long addr, int len, size_t width);
 #endif
 